@@ -4,11 +4,14 @@
 
 #include "zeek/zeek-config.h"
 
+#include <chrono>
 #include <cstring>
 #include <map>
 #include <vector>
 
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/Func.h"
+#include "zeek/ID.h"
 #include "zeek/IPAddr.h"
 #include "zeek/RE.h"
 #include "zeek/Reporter.h"
@@ -64,10 +67,16 @@ CompositeHash::CompositeHash(TypeListPtr composite_type) : type(std::move(compos
 	{
 	if ( type->GetTypes().size() == 1 )
 		is_singleton = true;
+
+	key_builder = FindKeyBuilder();
 	}
 
 std::unique_ptr<HashKey> CompositeHash::MakeHashKey(const Val& argv, bool type_check) const
 	{
+	if ( key_builder )
+		if ( auto k = (this->*key_builder)(argv) )
+			return k;
+
 	auto res = std::make_unique<HashKey>();
 	const auto& tl = type->GetTypes();
 
@@ -136,6 +145,187 @@ ListValPtr CompositeHash::RecoverVals(const HashKey& hk) const
 	return l;
 	}
 
+// The specialized key builders write their keys laid out the same way as
+// SingleValHash() would: addresses take 16 bytes aligned to 4 bytes, and
+// ports, like all unsigned values, 8 bytes aligned to 8 bytes. None of the
+// layouts below need any padding. A singleton string is just its bytes.
+static constexpr size_t ADDR_KEY_SIZE = sizeof(uint32_t) * 4;
+static constexpr size_t PORT_KEY_SIZE = sizeof(zeek_uint_t);
+
+// Returns a key with room for the given number of bytes, and a pointer to
+// them. The key counts as fully written.
+static std::unique_ptr<HashKey> make_fixed_key(size_t size, char** bytes)
+	{
+	auto hk = std::make_unique<HashKey>();
+	hk->Reserve("fixed", size);
+	hk->Allocate();
+	*bytes = static_cast<char*>(hk->KeyAtWrite());
+	hk->SkipWrite("fixed", size);
+	return hk;
+	}
+
+static void write_addr(char* bytes, const Val* v)
+	{
+	v->AsAddr().CopyIPv6(reinterpret_cast<uint32_t*>(bytes));
+	}
+
+static void write_port(char* bytes, const Val* v)
+	{
+	zeek_uint_t u = v->AsCount();
+	memcpy(bytes, &u, sizeof(u));
+	}
+
+// Returns an index value's single component, unwrapping it from a list if
+// needed, or nil if it's a list of a different length.
+static const Val* singleton_val(const Val& v)
+	{
+	if ( v.GetType()->Tag() != TYPE_LIST )
+		return &v;
+
+	auto lv = v.AsListVal();
+	return lv->Length() == 1 ? lv->Idx(0).get() : nullptr;
+	}
+
+// Returns true if v is a list of exactly the given types of values.
+static bool is_list_of(const Val& v, TypeTag t0, TypeTag t1)
+	{
+	if ( v.GetType()->Tag() != TYPE_LIST )
+		return false;
+
+	auto lv = v.AsListVal();
+	return lv->Length() == 2 && lv->Idx(0)->GetType()->Tag() == t0 &&
+	       lv->Idx(1)->GetType()->Tag() == t1;
+	}
+
+CompositeHash::KeyBuilder CompositeHash::FindKeyBuilder() const
+	{
+	const auto& tl = type->GetTypes();
+
+	if ( tl.size() == 1 )
+		{
+		switch ( tl[0]->Tag() )
+			{
+			case TYPE_ADDR:
+				return &CompositeHash::AddrKey;
+
+			case TYPE_STRING:
+				return &CompositeHash::StringKey;
+
+			case TYPE_RECORD:
+				{
+				// conn_id, or anything else of the same shape.
+				auto rt = tl[0]->AsRecordType();
+				static const TypeTag conn_id_tags[] = {TYPE_ADDR, TYPE_PORT, TYPE_ADDR, TYPE_PORT};
+
+				if ( rt->NumFields() != 4 )
+					return nullptr;
+
+				for ( int i = 0; i < 4; ++i )
+					{
+					const auto& attrs = rt->FieldDecl(i)->attrs;
+
+					if ( rt->GetFieldType(i)->Tag() != conn_id_tags[i] ||
+					     (attrs && attrs->Find(ATTR_OPTIONAL)) )
+						return nullptr;
+					}
+
+				return &CompositeHash::ConnIDKey;
+				}
+
+			default:
+				return nullptr;
+			}
+		}
+
+	if ( tl.size() == 2 && tl[0]->Tag() == TYPE_ADDR )
+		{
+		if ( tl[1]->Tag() == TYPE_PORT )
+			return &CompositeHash::AddrPortKey;
+
+		if ( tl[1]->Tag() == TYPE_ADDR )
+			return &CompositeHash::AddrAddrKey;
+		}
+
+	return nullptr;
+	}
+
+std::unique_ptr<HashKey> CompositeHash::AddrKey(const Val& v) const
+	{
+	auto a = singleton_val(v);
+
+	if ( ! a || a->GetType()->Tag() != TYPE_ADDR )
+		return nullptr;
+
+	char* bytes;
+	auto hk = make_fixed_key(ADDR_KEY_SIZE, &bytes);
+	write_addr(bytes, a);
+	return hk;
+	}
+
+std::unique_ptr<HashKey> CompositeHash::StringKey(const Val& v) const
+	{
+	auto s = singleton_val(v);
+
+	if ( ! s || s->GetType()->Tag() != TYPE_STRING )
+		return nullptr;
+
+	auto str = s->AsString();
+	char* bytes;
+	auto hk = make_fixed_key(str->Len(), &bytes);
+	memcpy(bytes, str->Bytes(), str->Len());
+	return hk;
+	}
+
+std::unique_ptr<HashKey> CompositeHash::AddrPortKey(const Val& v) const
+	{
+	if ( ! is_list_of(v, TYPE_ADDR, TYPE_PORT) )
+		return nullptr;
+
+	auto lv = v.AsListVal();
+	char* bytes;
+	auto hk = make_fixed_key(ADDR_KEY_SIZE + PORT_KEY_SIZE, &bytes);
+	write_addr(bytes, lv->Idx(0).get());
+	write_port(bytes + ADDR_KEY_SIZE, lv->Idx(1).get());
+	return hk;
+	}
+
+std::unique_ptr<HashKey> CompositeHash::AddrAddrKey(const Val& v) const
+	{
+	if ( ! is_list_of(v, TYPE_ADDR, TYPE_ADDR) )
+		return nullptr;
+
+	auto lv = v.AsListVal();
+	char* bytes;
+	auto hk = make_fixed_key(2 * ADDR_KEY_SIZE, &bytes);
+	write_addr(bytes, lv->Idx(0).get());
+	write_addr(bytes + ADDR_KEY_SIZE, lv->Idx(1).get());
+	return hk;
+	}
+
+std::unique_ptr<HashKey> CompositeHash::ConnIDKey(const Val& v) const
+	{
+	auto r = singleton_val(v);
+
+	// Values of other record types go through the generic code, even if
+	// they'd fit.
+	if ( ! r || r->GetType() != type->GetTypes()[0] )
+		return nullptr;
+
+	auto rv = r->AsRecordVal();
+
+	for ( int i = 0; i < 4; ++i )
+		if ( ! rv->HasField(i) )
+			return nullptr;
+
+	char* bytes;
+	auto hk = make_fixed_key(2 * (ADDR_KEY_SIZE + PORT_KEY_SIZE), &bytes);
+	write_addr(bytes, rv->GetField(0).get());
+	write_port(bytes + ADDR_KEY_SIZE, rv->GetField(1).get());
+	write_addr(bytes + ADDR_KEY_SIZE + PORT_KEY_SIZE, rv->GetField(2).get());
+	write_port(bytes + 2 * ADDR_KEY_SIZE + PORT_KEY_SIZE, rv->GetField(3).get());
+	return hk;
+	}
+
 bool CompositeHash::RecoverOneVal(const HashKey& hk, Type* t, ValPtr* pval, bool optional,
                                   bool singleton) const
 	{
@@ -952,3 +1142,168 @@ bool CompositeHash::ReserveSingleTypeKeySize(HashKey& hk, Type* bt, const Val* v
 	}
 
 	} // namespace zeek::detail
+
+namespace zeek
+	{
+
+namespace
+	{
+
+// A CompositeHash that always lays out keys through the generic code, for
+// comparison with the specialized key builders.
+class GenericCompositeHash : public detail::CompositeHash
+	{
+public:
+	explicit GenericCompositeHash(TypeListPtr t) : CompositeHash(std::move(t))
+		{
+		key_builder = nullptr;
+		}
+	};
+
+// An index type and matching index values for each of the shapes that have
+// specialized key builders.
+struct IndexShape
+	{
+	const char* name;
+	TypeListPtr type;
+	std::vector<ValPtr> vals;
+	};
+
+std::vector<IndexShape> index_shapes(int n)
+	{
+	auto make_type = [](std::initializer_list<TypePtr> types)
+	{
+		auto tl = make_intrusive<TypeList>(types.size() == 1 ? *types.begin() : nullptr);
+
+		for ( const auto& t : types )
+			tl->Append(t);
+
+		return tl;
+	};
+
+	auto addr = [](int i)
+	{
+		// Alternate IPv4 and IPv6 addresses.
+		auto text = i % 2 ? util::fmt("10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff)
+		                  : util::fmt("2001:db8::%x", i);
+		return make_intrusive<AddrVal>(text);
+	};
+
+	auto port = [](int i)
+	{
+		return val_mgr->Port(i % 65536, i % 3 ? TRANSPORT_TCP : TRANSPORT_UDP);
+	};
+
+	auto list = [](ValPtr a, ValPtr b)
+	{
+		auto lv = make_intrusive<ListVal>(TYPE_ANY);
+		lv->Append(std::move(a));
+		lv->Append(std::move(b));
+		return lv;
+	};
+
+	const auto& addr_t = base_type(TYPE_ADDR);
+	const auto& port_t = base_type(TYPE_PORT);
+
+	std::vector<IndexShape> shapes = {
+		{"addr", make_type({addr_t}), {}},
+		{"string", make_type({base_type(TYPE_STRING)}), {}},
+		{"[addr, port]", make_type({addr_t, port_t}), {}},
+		{"[addr, addr]", make_type({addr_t, addr_t}), {}},
+		{"conn_id", make_type({id::conn_id}), {}},
+	};
+
+	for ( int i = 0; i < n; ++i )
+		{
+		shapes[0].vals.emplace_back(addr(i));
+		shapes[1].vals.emplace_back(make_intrusive<StringVal>(util::fmt("key-%d", i)));
+		shapes[2].vals.emplace_back(list(addr(i), port(i)));
+		shapes[3].vals.emplace_back(list(addr(i), addr(i + 1)));
+
+		auto cid = make_intrusive<RecordVal>(id::conn_id);
+		cid->Assign(0, addr(i));
+		cid->Assign(1, port(i));
+		cid->Assign(2, addr(i + 1));
+		cid->Assign(3, port(i + 1));
+		shapes[4].vals.emplace_back(std::move(cid));
+		}
+
+	return shapes;
+	}
+
+bool same_key(const detail::HashKey& a, const detail::HashKey& b)
+	{
+	return a.Size() == b.Size() && memcmp(a.Key(), b.Key(), a.Size()) == 0 && a.Hash() == b.Hash();
+	}
+
+	} // namespace
+
+TEST_CASE("composite hash specialized keys")
+	{
+	for ( const auto& shape : index_shapes(100) )
+		{
+		CAPTURE(shape.name);
+
+		detail::CompositeHash fast(shape.type);
+		GenericCompositeHash generic(shape.type);
+
+		for ( const auto& v : shape.vals )
+			{
+			auto fk = fast.MakeHashKey(*v, true);
+			auto gk = generic.MakeHashKey(*v, true);
+			REQUIRE(fk);
+			REQUIRE(gk);
+			CHECK(same_key(*fk, *gk));
+
+			// Keys recover to values that hash the same again.
+			auto rv = fast.RecoverVals(*fk);
+			auto rk = fast.MakeHashKey(*rv, true);
+			REQUIRE(rk);
+			CHECK(same_key(*rk, *fk));
+			}
+		}
+
+	// Values of the wrong types still get rejected.
+	auto shapes = index_shapes(1);
+	detail::CompositeHash addr_port(shapes[2].type);
+	CHECK_FALSE(addr_port.MakeHashKey(*shapes[3].vals[0], true));
+	}
+
+TEST_CASE("composite hash benchmark" * doctest::skip())
+	{
+	// Run with: zeek --test --no-skip -tc="composite hash benchmark"
+	using clock = std::chrono::steady_clock;
+
+	constexpr int num_vals = 10000;
+	constexpr int rounds = 100;
+
+	// Returns nanoseconds per key built.
+	auto run = [&](const detail::CompositeHash& ch, const std::vector<ValPtr>& vals)
+	{
+		size_t total_size = 0;
+		auto start = clock::now();
+
+		for ( int r = 0; r < rounds; r++ )
+			for ( const auto& v : vals )
+				total_size += ch.MakeHashKey(*v, false)->Size();
+
+		auto elapsed = clock::now() - start;
+		CHECK(total_size > 0);
+
+		return std::chrono::duration<double, std::nano>(elapsed).count() / (rounds * vals.size());
+	};
+
+	for ( const auto& shape : index_shapes(num_vals) )
+		{
+		detail::CompositeHash fast(shape.type);
+		GenericCompositeHash generic(shape.type);
+
+		auto fast_ns = run(fast, shape.vals);
+		auto generic_ns = run(generic, shape.vals);
+
+		MESSAGE(shape.name << ": specialized " << fast_ns << " ns/key, generic " << generic_ns
+		                   << " ns/key");
+		}
+	}
+
+	} // namespace zeek
@@ -33,6 +33,23 @@ public:
 	ListValPtr RecoverVals(const HashKey& k) const;
 
 protected:
+	// A key builder specialized for a common index type, such as addr or
+	// [addr, port]. These write the same keys as SingleValHash(), but with
+	// a fixed layout instead of per-component type dispatch. They return
+	// nil if the value doesn't have the expected shape, in which case the
+	// generic code takes over, including for type checking.
+	using KeyBuilder = std::unique_ptr<HashKey> (CompositeHash::*)(const Val& v) const;
+
+	// Returns the specialized key builder for our index type, or nil if
+	// there's none.
+	KeyBuilder FindKeyBuilder() const;
+
+	std::unique_ptr<HashKey> AddrKey(const Val& v) const;
+	std::unique_ptr<HashKey> StringKey(const Val& v) const;
+	std::unique_ptr<HashKey> AddrPortKey(const Val& v) const;
+	std::unique_ptr<HashKey> AddrAddrKey(const Val& v) const;
+	std::unique_ptr<HashKey> ConnIDKey(const Val& v) const;
+
 	bool SingleValHash(HashKey& hk, const Val* v, Type* bt, bool type_check, bool optional,
 	                   bool singleton) const;
 
@@ -68,6 +85,7 @@ protected:
 
 	TypeListPtr type;
 	bool is_singleton = false; // if just one type in index
+	KeyBuilder key_builder = nullptr;
 	};
 
 	} // namespace zeek::detail
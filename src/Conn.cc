@@ -10,6 +10,7 @@
 #include "zeek/Desc.h"
 #include "zeek/Event.h"
 #include "zeek/NetVar.h"
+#include "zeek/ObjectPool.h"
 #include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/Timer.h"
@@ -18,6 +19,7 @@
 #include "zeek/analyzer/Manager.h"
 #include "zeek/analyzer/protocol/pia/PIA.h"
 #include "zeek/iosource/IOSource.h"
+#include "zeek/packet_analysis/Manager.h"
 #include "zeek/packet_analysis/protocol/ip/SessionAdapter.h"
 #include "zeek/packet_analysis/protocol/tcp/TCP.h"
 #include "zeek/session/Manager.h"
@@ -90,6 +92,24 @@ Connection::~Connection()
 	--current_connections;
 	}
 
+static detail::ObjectPool& connection_pool()
+	{
+	// Never destroyed, as connections may still get released during
+	// static destruction.
+	static auto* pool = new detail::ObjectPool("connection", sizeof(Connection));
+	return *pool;
+	}
+
+void* Connection::operator new(size_t size)
+	{
+	return connection_pool().Allocate(size);
+	}
+
+void Connection::operator delete(void* ptr, size_t size)
+	{
+	connection_pool().Free(ptr, size);
+	}
+
 void Connection::CheckEncapsulation(const std::shared_ptr<EncapsulationStack>& arg_encap)
 	{
 	if ( encapsulation && arg_encap )
@@ -175,6 +195,17 @@ void Connection::NextPacket(double t, bool is_orig, const IP_Hdr* ip, int len, i
 	run_state::current_pkt = nullptr;
 	}
 
+double Connection::ShuntedLastTime() const
+	{
+	packet_analysis::ShuntTable::Stats stats;
+
+	if ( ! packet_mgr->GetShuntTable().Lookup(orig_addr, ntohs(orig_port), resp_addr,
+	                                          ntohs(resp_port), proto, &stats) )
+		return 0.0;
+
+	return stats.last_seen;
+	}
+
 bool Connection::IsReuse(double t, const u_char* pkt)
 	{
 	return adapter && adapter->IsReuse(t, pkt);
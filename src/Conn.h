@@ -83,6 +83,10 @@ public:
 	           const Packet* pkt);
 	~Connection() override;
 
+	// Connections are allocated from a dedicated ObjectPool.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	/**
 	 * Invoked when an encapsulation is discovered. It records the encapsulation
 	 * with the connection and raises a "tunnel_changed" event if it's different
@@ -149,6 +153,8 @@ public:
 			return "unknown";
 		}
 
+	double ShuntedLastTime() const override;
+
 	// Returns true if the packet reflects a reuse of this
 	// connection (i.e., not a continuation but the beginning of
 	// a new connection).
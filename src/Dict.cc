@@ -2,6 +2,10 @@
 
 #include "zeek/Dict.h"
 
+#include <chrono>
+#include <random>
+#include <set>
+
 #include "zeek/3rdparty/doctest.h"
 #include "zeek/Hash.h"
 
@@ -453,6 +457,277 @@ TEST_CASE("dict iterator invalidation")
 	delete key3;
 	}
 
+TEST_CASE("dict lookups across resizes and removals")
+	{
+	// Checks every lookup against the set of keys known to be present while the table
+	// grows, remaps incrementally, has entries removed, and shrinks again, so that the
+	// control bytes must follow all of the entries' moves.
+	constexpr uint32_t num_keys = 4096;
+
+	PDict<uint32_t> dict;
+	std::vector<uint32_t> vals(num_keys);
+	std::set<uint32_t> present;
+	std::mt19937 rng(42);
+
+	for ( int round = 0; round < 50000; round++ )
+		{
+		uint32_t k = rng() % num_keys;
+		detail::HashKey key(k);
+
+		// Every so often, mostly remove entries for a while so that the table shrinks.
+		bool removing = (round / 5000) % 2 == 1;
+
+		if ( removing ? rng() % 20 != 0 : rng() % 3 == 0 )
+			{
+			dict.Remove(&key);
+			present.erase(k);
+			}
+		else
+			{
+			vals[k] = k;
+			dict.Insert(&key, &vals[k]);
+			present.insert(k);
+			}
+
+		uint32_t probe = rng() % num_keys;
+		detail::HashKey probe_key(probe);
+		uint32_t* v = dict.Lookup(&probe_key);
+
+		REQUIRE((v != nullptr) == (present.count(probe) > 0));
+
+		if ( v )
+			CHECK(*v == probe);
+		}
+
+	CHECK(dict.Length() == static_cast<int>(present.size()));
+	}
+
+TEST_CASE("dict shrinking")
+	{
+	// Fills the table, then removes most of the entries again while lookups and an
+	// iteration run alongside, and checks that the table returns to a small size.
+	constexpr uint32_t num_keys = 20000;
+	constexpr uint32_t num_kept = 200;
+
+	PDict<uint32_t> dict;
+	std::vector<uint32_t> vals(num_keys);
+
+	for ( uint32_t i = 0; i < num_keys; i++ )
+		{
+		vals[i] = i;
+		detail::HashKey key(i);
+		dict.Insert(&key, &vals[i]);
+		}
+
+	int peak_capacity = dict.Capacity();
+
+	// Removing entries while a robust iteration is going on must not shrink the table
+	// underneath it.
+	int count = 0;
+	for ( auto it = dict.begin_robust(); it != dict.end_robust(); ++it )
+		{
+		if ( *it->value >= num_keys / 2 )
+			{
+			detail::HashKey key(*it->value);
+			dict.Remove(&key);
+			}
+
+		count++;
+		}
+
+	CHECK(count == num_keys);
+	CHECK(dict.Capacity() == peak_capacity);
+
+	for ( uint32_t i = num_kept; i < num_keys / 2; i++ )
+		{
+		detail::HashKey key(i);
+		CHECK(dict.Remove(&key) == &vals[i]);
+
+		uint32_t probe = i % num_kept;
+		detail::HashKey probe_key(probe);
+		REQUIRE(dict.Lookup(&probe_key) == &vals[probe]);
+		}
+
+	// Keep the table busy until all entries have moved.
+	for ( int i = 0; i < 1000; i++ )
+		{
+		detail::HashKey key(num_keys);
+		dict.Insert(&key, &vals[0]);
+		dict.Remove(&key);
+		}
+
+	CHECK(dict.Length() == num_kept);
+	CHECK(dict.Capacity() < peak_capacity / 16);
+
+	count = 0;
+	for ( const auto& entry : dict )
+		{
+		CHECK(*entry.value < num_kept);
+		count++;
+		}
+
+	CHECK(count == num_kept);
+
+	for ( uint32_t i = 0; i < num_keys; i++ )
+		{
+		detail::HashKey key(i);
+		REQUIRE(dict.Lookup(&key) == (i < num_kept ? &vals[i] : nullptr));
+		}
+
+	// Growing again works as before.
+	for ( uint32_t i = num_kept; i < num_keys; i++ )
+		{
+		detail::HashKey key(i);
+		dict.Insert(&key, &vals[i]);
+		}
+
+	CHECK(dict.Length() == num_keys);
+
+	for ( uint32_t i = 0; i < num_keys; i++ )
+		{
+		detail::HashKey key(i);
+		REQUIRE(dict.Lookup(&key) == &vals[i]);
+		}
+	}
+
+TEST_CASE("dict failed shrinking")
+	{
+	// Crowds entries into the last bucket of a 64-bucket table, so that their cluster runs past
+	// the end of it and shrinking to that size has to be called off. Further removals must not
+	// keep retrying it, and once enough entries are gone, shrinking works again.
+	constexpr int crowd_bits = 6;
+	constexpr uint32_t num_crowded = 12;
+	constexpr uint32_t num_others = 4000;
+
+	// The buckets come from the low bits of the hash times this (odd) constant, so multiplying
+	// the wanted bits by its inverse gives a hash that lands there.
+#ifdef DICT_NO_FIB_HASH
+	uint64_t mult = 1;
+#else
+	uint64_t mult = 11400714819323198485llu;
+#endif
+	uint64_t inverse = mult;
+	for ( int i = 0; i < 5; i++ )
+		inverse *= 2 - mult * inverse;
+
+	PDict<uint32_t> dict;
+	std::vector<uint32_t> vals(num_others);
+	std::vector<detail::HashKey> crowded;
+
+	for ( uint32_t i = 0; i < num_crowded; i++ )
+		{
+		// The last bucket for 2^crowd_bits buckets, but one in the middle for twice that.
+		uint64_t bucket = (1 << crowd_bits) - 1;
+		uint64_t hash = (bucket * inverse) & ((2 << crowd_bits) - 1);
+		hash += uint64_t(i + 1) << (crowd_bits + 1);
+
+		uint32_t k = num_others + i;
+		crowded.emplace_back(&k, sizeof(k), hash);
+		}
+
+	for ( uint32_t i = 0; i < num_others; i++ )
+		{
+		vals[i] = i;
+		detail::HashKey key(i);
+		dict.Insert(&key, &vals[i]);
+		}
+
+	for ( uint32_t i = 0; i < num_crowded; i++ )
+		dict.Insert(&crowded[i], &vals[i]);
+
+	for ( uint32_t i = 0; i < num_others; i++ )
+		{
+		detail::HashKey key(i);
+		dict.Remove(&key);
+		}
+
+	// Too many entries remain for 32 buckets, and 64 didn't work out.
+	int capacity = dict.Capacity();
+	CHECK(capacity == (2 << crowd_bits) + crowd_bits + 1);
+
+	for ( int i = 0; i < 1000; i++ )
+		{
+		detail::HashKey key(num_others + num_crowded);
+		dict.Insert(&key, &vals[0]);
+		dict.Remove(&key);
+		}
+
+	CHECK(dict.Capacity() == capacity);
+
+	for ( uint32_t i = 0; i < num_crowded; i++ )
+		REQUIRE(dict.Lookup(&crowded[i]) == &vals[i]);
+
+	for ( uint32_t i = num_crowded / 2; i < num_crowded; i++ )
+		CHECK(dict.Remove(&crowded[i]) == &vals[i]);
+
+	for ( int i = 0; i < 1000; i++ )
+		{
+		detail::HashKey key(num_others + num_crowded);
+		dict.Insert(&key, &vals[0]);
+		dict.Remove(&key);
+		}
+
+	CHECK(dict.Capacity() < capacity);
+	CHECK(dict.Length() == num_crowded / 2);
+
+	for ( uint32_t i = 0; i < num_crowded; i++ )
+		REQUIRE(dict.Lookup(&crowded[i]) == (i < num_crowded / 2 ? &vals[i] : nullptr));
+	}
+
+TEST_CASE("dict lookup benchmark" * doctest::skip())
+	{
+	// Run with: zeek --test --no-skip -tc="dict lookup benchmark"
+	//
+	// To compare with walking the entries one by one, build with
+	// -DDICT_NO_CTRL_BYTES.
+	using clock = std::chrono::steady_clock;
+
+	constexpr uint32_t num_keys = 100000;
+	constexpr int rounds = 20;
+
+	PDict<uint32_t> dict;
+	std::vector<uint32_t> vals(num_keys);
+	std::vector<detail::HashKey> hits;
+	std::vector<detail::HashKey> misses;
+
+	for ( uint32_t i = 0; i < num_keys; i++ )
+		{
+		vals[i] = i;
+		detail::HashKey key(i);
+		dict.Insert(&key, &vals[i]);
+
+		hits.emplace_back(i);
+		misses.emplace_back(i + num_keys);
+		}
+
+	// Returns nanoseconds per lookup and the number of keys found.
+	auto run = [&](const std::vector<detail::HashKey>& keys)
+	{
+		uint64_t found = 0;
+		auto start = clock::now();
+
+		for ( int r = 0; r < rounds; r++ )
+			for ( const auto& key : keys )
+				if ( dict.Lookup(&key) )
+					++found;
+
+		auto elapsed = clock::now() - start;
+
+		return std::make_pair(std::chrono::duration<double, std::nano>(elapsed).count() /
+		                          (rounds * keys.size()),
+		                      found);
+	};
+
+	auto [hit_ns, hits_found] = run(hits);
+	auto [miss_ns, misses_found] = run(misses);
+
+	MESSAGE(num_keys << " entries, capacity " << dict.Capacity());
+	MESSAGE("successful lookups:   " << hit_ns << " ns/op");
+	MESSAGE("unsuccessful lookups: " << miss_ns << " ns/op");
+	CHECK(hits_found == rounds * num_keys);
+	CHECK(misses_found == 0);
+	}
+
 // private
 void generic_delete_func(void* v)
 	{
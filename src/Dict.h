@@ -9,6 +9,14 @@
 #include <memory>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "zeek/Hash.h"
 #include "zeek/Obj.h"
 #include "zeek/Reporter.h"
@@ -62,6 +70,12 @@ constexpr int DICT_LOAD_FACTOR_100 = 75;
 // factor is already lower than MIN_DICT_LOAD_FACTOR_100.
 constexpr int SPACE_DISTANCE_THRESHOLD = 32;
 
+// Once fewer than DICT_SHRINK_LOAD_FACTOR_100 percent of the table's positions are in use,
+// shrink it so that about DICT_SHRINK_TARGET_LOAD_FACTOR_100 percent are. Both stay well below
+// the load factors at which the table grows, so that it doesn't keep resizing back and forth.
+constexpr int DICT_SHRINK_LOAD_FACTOR_100 = 10;
+constexpr int DICT_SHRINK_TARGET_LOAD_FACTOR_100 = 20;
+
 // To ignore occasional faraway spaces. only when space_distance_samples are above
 // MIN_SPACE_DISTANCE_SAMPLES, we consider space_distance is not by chance.
 constexpr int MIN_SPACE_DISTANCE_SAMPLES = 128;
@@ -79,6 +93,53 @@ constexpr uint8_t DICT_THRESHOLD_BITS = 3;
 // bucket at which to start looking for the next value to return.
 constexpr uint16_t TOO_FAR_TO_REACH = 0xFFFF;
 
+// Alongside the table, each position has a control byte holding a 7-bit fingerprint of its
+// entry's hash, or DICT_CTRL_EMPTY if the position is empty. Lookups compare the control bytes
+// DICT_GROUP_SIZE at a time against the fingerprint they're looking for and only examine the
+// entries that match, so that a miss usually costs one or two vector compares. Build with
+// -DDICT_NO_CTRL_BYTES to walk the entries one by one instead.
+constexpr uint8_t DICT_CTRL_EMPTY = 0x80;
+constexpr int DICT_GROUP_SIZE = 16;
+
+// Returns a bitmask with bit i set if the i'th of the DICT_GROUP_SIZE control bytes starting
+// at ctrl equals v.
+inline uint32_t MatchCtrlGroup(const uint8_t* ctrl, uint8_t v)
+	{
+#if defined(__SSE2__)
+	auto group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+	auto match = _mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(v)));
+	return static_cast<uint32_t>(_mm_movemask_epi8(match));
+#else
+	uint32_t mask = 0;
+	for ( int i = 0; i < DICT_GROUP_SIZE; i++ )
+		if ( ctrl[i] == v )
+			mask |= 1u << i;
+	return mask;
+#endif
+	}
+
+// Returns the index of the lowest set bit of a MatchCtrlGroup() mask, which must not be 0.
+inline int LowestCtrlMatch(uint32_t mask)
+	{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+	}
+
+// Hints to the CPU that the given address will be read soon.
+inline void PrefetchForRead(const void* p)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(p);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#endif
+	}
+
 /**
  * An entry stored in the dictionary.
  */
@@ -557,6 +618,10 @@ private:
  * The dictionary is effectively a hashmap from hashed keys to values. The dictionary owns
  * the keys but not the values. The dictionary size will be bounded at around 100K. 1M
  * entries is the absolute limit. Only Connections use that many entries, and that is rare.
+ *
+ * Lookups that don't need an insert position probe an array of per-position control bytes
+ * holding hash fingerprints, in the manner of SwissTable, instead of walking the entries;
+ * see DICT_CTRL_EMPTY.
  */
 template <typename T> class Dictionary
 	{
@@ -602,6 +667,25 @@ public:
 		return Dictionary<T>::Lookup(&h);
 		}
 
+	// Like Lookup(), but also returns the position of the key's entry in
+	// the order in which iterating over an unordered dictionary visits its
+	// entries.  Positions are only comparable as long as the dictionary
+	// doesn't change.
+	T* Lookup(const detail::HashKey* key, int* position) const
+		{
+		ASSERT(! IsOrdered());
+
+		// Unlike other lookups, this must not move the entry to its place
+		// for the current table size, which changes where iterating finds
+		// it.  Lookups leave entries alone while there are iterators.
+		Dictionary* d = const_cast<Dictionary*>(this);
+		d->IncrIters();
+		*position = d->LookupIndex(key->Key(), key->Size(), key->Hash());
+		d->DecrIters();
+
+		return *position >= 0 ? table[*position].value : nullptr;
+		}
+
 	// Returns previous value, or 0 if none.
 	// If iterators_invalidated is supplied, its value is set to true
 	// if the removal may have invalidated any existing iterators.
@@ -714,6 +798,8 @@ public:
 		// cycle, a possible hiccup point.
 		if ( Remapping() )
 			Remap();
+		else if ( SizingDown() )
+			RemapDown();
 		ASSERT_VALID(this);
 		return v;
 		}
@@ -772,6 +858,17 @@ public:
 
 		T* v = entry.value;
 		entry.Clear();
+
+		// A shrink that failed might work out once enough further entries have gone.
+		if ( failed_shrink_log2_buckets && num_entries <= failed_shrink_entries / 2 )
+			failed_shrink_log2_buckets = 0;
+
+		if ( ! SizingDown() && ShouldSizeDown() )
+			SizeDown();
+
+		if ( SizingDown() )
+			RemapDown();
+
 		ASSERT_VALID(this);
 		return v;
 		}
@@ -850,6 +947,9 @@ public:
 			table = nullptr;
 			}
 
+		free(ctrl);
+		ctrl = nullptr;
+
 		if ( order )
 			order.reset();
 
@@ -862,6 +962,8 @@ public:
 		num_iterators = 0;
 		remaps = 0;
 		remap_end = -1;
+		shrink_end = -1;
+		failed_shrink_log2_buckets = 0;
 		num_entries = 0;
 		max_entries = 0;
 		}
@@ -1239,6 +1341,46 @@ private:
 		table = (detail::DictEntry<T>*)malloc(sizeof(detail::DictEntry<T>) * ExpectedCapacity());
 		for ( int i = Capacity() - 1; i >= 0; i-- )
 			table[i].SetEmpty();
+
+		ResizeCtrl(0);
+		}
+
+	// Resizes the control bytes to the table's current capacity, marking new positions
+	// empty. There's a group's worth of extra empty positions at the end so that lookups
+	// can always load full groups.
+	void ResizeCtrl(int prev_capacity)
+		{
+#ifndef DICT_NO_CTRL_BYTES
+		int capacity = Capacity();
+		ctrl = (uint8_t*)realloc(ctrl, capacity + detail::DICT_GROUP_SIZE);
+
+		// When shrinking, the positions past the new end are all empty already.
+		if ( capacity > prev_capacity )
+			memset(ctrl + prev_capacity, detail::DICT_CTRL_EMPTY,
+			       capacity - prev_capacity + detail::DICT_GROUP_SIZE);
+#endif
+		}
+
+	// Returns the control byte for an entry with the given hash. This uses the top bits of
+	// the FibHash, whereas the buckets come from the bottom ones.
+	uint8_t CtrlByte(detail::hash_t h) const { return static_cast<uint8_t>(FibHash(h) >> 57); }
+
+	// Stores an entry at a position, keeping its control byte in sync.
+	void SetEntry(int position, const detail::DictEntry<T>& entry)
+		{
+		table[position] = entry;
+#ifndef DICT_NO_CTRL_BYTES
+		ctrl[position] = CtrlByte(entry.hash);
+#endif
+		}
+
+	// Empties a position, keeping its control byte in sync.
+	void SetEmpty(int position)
+		{
+		table[position].SetEmpty();
+#ifndef DICT_NO_CTRL_BYTES
+		ctrl[position] = detail::DICT_CTRL_EMPTY;
+#endif
 		}
 
 	// Lookup
@@ -1293,6 +1435,26 @@ private:
 					}
 				}
 			}
+
+		// While shrinking, the entry may still be in its bucket for the larger size.
+		if ( SizingDown() )
+			{
+			int prev_bucket = BucketByHash(hash, shrink_log2_buckets);
+			if ( prev_bucket >= Buckets() && prev_bucket <= shrink_end )
+				{
+				position = LookupIndex(key, key_size, hash, prev_bucket, Capacity());
+				if ( position >= 0 )
+					{
+					ASSERT_EQUAL(position, linear_position); // same as linearLookup
+					if ( ! num_iterators )
+						{
+						Remap(position, &position);
+						ASSERT_EQUAL(position, LookupIndex(key, key_size, hash));
+						}
+					return position;
+					}
+				}
+			}
 		// not found
 #ifdef ZEEK_DICT_DEBUG
 		if ( linear_position >= 0 )
@@ -1312,7 +1474,13 @@ private:
 	int LookupIndex(const void* key, int key_size, detail::hash_t hash, int begin, int end,
 	                int* insert_position = nullptr, int* insert_distance = nullptr)
 		{
-		ASSERT(begin >= 0 && begin < Buckets());
+		ASSERT(begin >= 0 && begin < Capacity());
+
+#ifndef DICT_NO_CTRL_BYTES
+		if ( ! insert_position && ! insert_distance )
+			return ProbeIndex(key, key_size, hash, begin, end);
+#endif
+
 		int i = begin;
 		for ( ; i < end && ! table[i].Empty() && BucketByPosition(i) <= begin; i++ )
 			if ( BucketByPosition(i) == begin && table[i].Equal((char*)key, key_size, hash) )
@@ -1334,6 +1502,45 @@ private:
 		return -1;
 		}
 
+#ifndef DICT_NO_CTRL_BYTES
+	// Like LookupIndex(), but examines only the entries whose control bytes match the key's,
+	// up to the first empty position. That range includes the whole cluster of the bucket.
+	int ProbeIndex(const void* key, int key_size, detail::hash_t hash, int begin, int end) const
+		{
+		uint8_t fingerprint = CtrlByte(hash);
+
+		// A hit will most likely be at the bucket itself. Fetch that entry while looking
+		// at the control bytes.
+		detail::PrefetchForRead(&table[begin]);
+
+		for ( int i = begin; i < end; i += detail::DICT_GROUP_SIZE )
+			{
+			uint32_t empty = detail::MatchCtrlGroup(ctrl + i, detail::DICT_CTRL_EMPTY);
+			uint32_t match = detail::MatchCtrlGroup(ctrl + i, fingerprint);
+
+			// Only the positions before the first empty one can be part of the cluster.
+			if ( empty )
+				match &= (empty & (~empty + 1)) - 1;
+
+			for ( ; match; match &= match - 1 )
+				{
+				int position = i + detail::LowestCtrlMatch(match);
+				if ( position >= end )
+					break;
+
+				if ( BucketByPosition(position) == begin &&
+				     table[position].Equal((const char*)key, key_size, hash) )
+					return position;
+				}
+
+			if ( empty )
+				break;
+			}
+
+		return -1;
+		}
+#endif
+
 	/// Insert entry, Adjust iterators when necessary.
 	void InsertRelocateAndAdjust(detail::DictEntry<T>& entry, int insert_position)
 		{
@@ -1355,6 +1562,9 @@ private:
 			remap_end = last_affected_position; // adjust to j on the conservative side.
 			}
 
+		// Likewise for entries still waiting to move to their smaller bucket.
+		AdjustShrinkEnd(insert_position, last_affected_position);
+
 		if ( iterators && ! iterators->empty() )
 			for ( auto c : *iterators )
 				AdjustOnInsert(c, entry, insert_position, last_affected_position);
@@ -1371,14 +1581,14 @@ private:
 				ASSERT(insert_position == Capacity());
 				SizeUp(); // copied all the items to new table. as it's just copying without
 				          // remapping, insert_position is now empty.
-				table[insert_position] = entry;
+				SetEntry(insert_position, entry);
 				if ( last_affected_position )
 					*last_affected_position = insert_position;
 				return;
 				}
 			if ( table[insert_position].Empty() )
 				{ // the condition to end the loop.
-				table[insert_position] = entry;
+				SetEntry(insert_position, entry);
 				if ( last_affected_position )
 					*last_affected_position = insert_position;
 				return;
@@ -1390,7 +1600,7 @@ private:
 			t.distance += next - insert_position;
 
 			// swap
-			table[insert_position] = entry;
+			SetEntry(insert_position, entry);
 			entry = t;
 			insert_position = next; // append to the end of the current cluster.
 			}
@@ -1449,13 +1659,13 @@ private:
 				{
 				// no next cluster to fill, or next position is empty or next position is already in
 				// perfect bucket.
-				table[position].SetEmpty();
+				SetEmpty(position);
 				if ( last_affected_position )
 					*last_affected_position = position;
 				return entry;
 				}
 			int next = TailOfClusterByPosition(position + 1);
-			table[position] = table[next];
+			SetEntry(position, table[next]);
 			table[position].distance -= next - position; // distance improved for the item.
 			position = next;
 			}
@@ -1549,15 +1759,20 @@ private:
 		if ( new_position )
 			*new_position = insert_position;
 		entry.distance = insert_position - expected;
-		InsertAndRelocate(
-			entry,
-			insert_position); // no iteration cookies to adjust, no need for last_affected_position.
+		int last_affected_position = insert_position;
+		InsertAndRelocate(entry, insert_position, &last_affected_position);
+		AdjustShrinkEnd(insert_position, last_affected_position);
 		ASSERT_VALID(this);
 		return true;
 		}
 
 	void SizeUp()
 		{
+		if ( SizingDown() )
+			CancelSizeDown();
+
+		failed_shrink_log2_buckets = 0;
+
 		int prev_capacity = Capacity();
 		SetLog2Buckets(log2_buckets + 1);
 
@@ -1566,6 +1781,8 @@ private:
 		for ( int i = prev_capacity; i < capacity; i++ )
 			table[i].SetEmpty();
 
+		ResizeCtrl(prev_capacity);
+
 		// REmap from last to first in reverse order. SizeUp can be triggered by 2 conditions, one
 		// of which is that the last space in the table is occupied and there's nowhere to put new
 		// items. In this case, the table doubles in capacity and the item is put at the
@@ -1581,6 +1798,119 @@ private:
 		space_distance_samples = 0;
 		}
 
+	bool SizingDown() const { return shrink_end >= 0; }
+
+	bool ShouldSizeDown() const
+		{
+		// Shrinking moves entries around, so wait for any iterations to finish. Same for
+		// a pending remap after growing, which wouldn't know about the smaller size. After
+		// a failed shrink, only sizes larger than the one that failed are worth trying.
+		return log2_buckets > detail::DICT_THRESHOLD_BITS + 1 &&
+		       log2_buckets > failed_shrink_log2_buckets + 1 && num_iterators == 0 &&
+		       ! Remapping() &&
+		       static_cast<int>(num_entries) <
+		           Capacity() * detail::DICT_SHRINK_LOAD_FACTOR_100 / 100;
+		}
+
+	// Reduces the number of buckets after many entries have been removed. As with SizeUp(),
+	// the entries move to their new buckets incrementally, through RemapDown(). The table
+	// keeps its size until they all have, since until then lookups also need to check the
+	// buckets that entries had for the previous size.
+	void SizeDown()
+		{
+		int log2 = log2_buckets;
+		while ( log2 > detail::DICT_THRESHOLD_BITS + 1 && log2 > failed_shrink_log2_buckets + 1 &&
+		        static_cast<int>(num_entries) <
+		            ((1 << (log2 - 1)) + log2 - 1) * detail::DICT_SHRINK_TARGET_LOAD_FACTOR_100 /
+		                100 )
+			log2--;
+
+		shrink_log2_buckets = log2_buckets;
+		log2_buckets = log2;
+		bucket_count = 1 << log2_buckets;
+
+		// A bucket's low bits are the same for all sizes, so only the entries of buckets
+		// beyond the new ones need to move, and they can't be below those buckets.
+		shrink_end = Capacity() - 1;
+
+		// reset performance metrics.
+		space_distance_sum = 0;
+		space_distance_samples = 0;
+		}
+
+	// One round of moving entries to their buckets for the smaller size, working down from
+	// the end of the table. Once all have moved, the table gets truncated.
+	void RemapDown()
+		{
+		// Same as for Remap().
+		if ( num_iterators > 0 )
+			return;
+
+		// Stepping over a position costs much less than moving its entry, but there may be
+		// long stretches of positions without anything to move.
+		int left = detail::DICT_REMAP_ENTRIES * 8;
+		while ( SizingDown() && shrink_end >= Buckets() && left > 0 )
+			{
+			if ( ! table[shrink_end].Empty() && BucketByPosition(shrink_end) >= Buckets() )
+				{
+				Remap(shrink_end);
+				left -= 8;
+				}
+			else
+				{
+				shrink_end--;
+				left--;
+				}
+			}
+
+		if ( SizingDown() && shrink_end < Buckets() )
+			FinishSizeDown();
+		}
+
+	void FinishSizeDown()
+		{
+		int prev_capacity = Capacity();
+		int capacity = (1 << log2_buckets) + log2_buckets;
+
+		for ( int i = capacity; i < prev_capacity; i++ )
+			if ( ! table[i].Empty() )
+				{
+				// A cluster runs past the end of the smaller table. This should be quite
+				// rare at the load factors we shrink at, so just stay at the current size.
+				// Remember the size, as the next Remove() would otherwise try it again
+				// right away, and fail the same way.
+				failed_shrink_log2_buckets = log2_buckets;
+				failed_shrink_entries = num_entries;
+				CancelSizeDown();
+				return;
+				}
+
+		shrink_end = -1;
+		bucket_capacity = capacity;
+		table = (detail::DictEntry<T>*)realloc(table, capacity * sizeof(detail::DictEntry<T>));
+		ResizeCtrl(prev_capacity);
+		}
+
+	// Goes back to the size the table had before SizeDown(). The entries that have moved
+	// already then get remapped to their previous buckets like after SizeUp().
+	void CancelSizeDown()
+		{
+		ASSERT(! Remapping());
+		int log2 = log2_buckets;
+		SetLog2Buckets(shrink_log2_buckets);
+		remaps = log2_buckets - log2;
+		remap_end = Capacity() - 1;
+		shrink_end = -1;
+		}
+
+	// Moves shrink_end up if an insertion in [insert_position, last_affected_position] may
+	// have pushed an entry that still needs to move to its smaller bucket across it.
+	void AdjustShrinkEnd(int insert_position, int last_affected_position)
+		{
+		if ( SizingDown() && insert_position <= shrink_end && shrink_end < last_affected_position )
+			shrink_end = last_affected_position;
+		}
+
 	/**
 	 * Retrieves a pointer to a full DictEntry in the table based on a hash key.
 	 *
@@ -1718,6 +2048,16 @@ private:
 	// The last index to be remapped.
 	int32_t remap_end = -1;
 
+	// While shrinking, the last position that may hold an entry still in its bucket for the
+	// previous size, log2 shrink_log2_buckets.
+	int32_t shrink_end = -1;
+	uint16_t shrink_log2_buckets = 0;
+
+	// The smaller size that the last shrink failed to reach, with the number of entries
+	// at the time, or 0 if there's none.
+	uint16_t failed_shrink_log2_buckets = 0;
+	uint32_t failed_shrink_entries = 0;
+
 	uint32_t num_entries = 0;
 	uint32_t max_entries = 0;
 	uint64_t cum_entries = 0;
@@ -1727,6 +2067,7 @@ private:
 
 	dict_delete_func delete_func = nullptr;
 	detail::DictEntry<T>* table = nullptr;
+	uint8_t* ctrl = nullptr; // control bytes, see DICT_CTRL_EMPTY
 	std::vector<RobustDictIterator<T>*>* iterators = nullptr;
 
 	// Ordered dictionaries keep the order based on some criteria, by default the order of
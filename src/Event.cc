@@ -7,6 +7,7 @@
 #include "zeek/Desc.h"
 #include "zeek/Func.h"
 #include "zeek/NetVar.h"
+#include "zeek/ObjectPool.h"
 #include "zeek/Trigger.h"
 #include "zeek/Val.h"
 #include "zeek/iosource/Manager.h"
@@ -21,12 +22,35 @@ namespace zeek
 Event::Event(const EventHandlerPtr& arg_handler, zeek::Args arg_args,
              util::detail::SourceID arg_src, analyzer::ID arg_aid, Obj* arg_obj, double arg_ts)
 	: handler(arg_handler), args(std::move(arg_args)), src(arg_src), aid(arg_aid), ts(arg_ts),
-	  obj(arg_obj), next_event(nullptr)
+	  obj(arg_obj)
 	{
 	if ( obj )
 		Ref(obj);
 	}
 
+Event::~Event()
+	{
+	detail::RecycleArgs(std::move(args));
+	}
+
+static detail::ObjectPool& event_pool()
+	{
+	// Never destroyed, as events may still get released during static
+	// destruction.
+	static auto* pool = new detail::ObjectPool("event", sizeof(Event));
+	return *pool;
+	}
+
+void* Event::operator new(size_t size)
+	{
+	return event_pool().Allocate(size);
+	}
+
+void Event::operator delete(void* ptr, size_t size)
+	{
+	event_pool().Free(ptr, size);
+	}
+
 void Event::Describe(ODesc* d) const
 	{
 	if ( d->IsReadable() )
@@ -68,9 +92,12 @@ void Event::Dispatch(bool no_remote)
 		reporter->EndErrorHandler();
 	}
 
+// Initial capacity of the event queue. Must be a power of two.
+static constexpr size_t INITIAL_QUEUE_SIZE = 1024;
+
 EventMgr::EventMgr()
 	{
-	head = tail = nullptr;
+	queue.resize(INITIAL_QUEUE_SIZE);
 	current_src = util::detail::SOURCE_LOCAL;
 	current_aid = 0;
 	current_ts = 0;
@@ -80,12 +107,8 @@ EventMgr::EventMgr()
 
 EventMgr::~EventMgr()
 	{
-	while ( head )
-		{
-		Event* n = head->NextEvent();
-		Unref(head);
-		head = n;
-		}
+	while ( queue_len > 0 )
+		Unref(PopEvent());
 
 	Unref(src_val);
 	}
@@ -103,20 +126,30 @@ void EventMgr::QueueEvent(Event* event)
 	if ( done )
 		return;
 
-	if ( ! head )
-		{
-		head = tail = event;
+	if ( queue_len == queue.size() )
+		GrowQueue();
+
+	queue[(queue_head + queue_len) & (queue.size() - 1)] = event;
+
+	if ( ++queue_len == 1 )
 		queue_flare.Fire();
-		}
-	else
-		{
-		tail->SetNext(event);
-		tail = event;
-		}
 
 	++event_mgr.num_events_queued;
 	}
 
+void EventMgr::GrowQueue()
+	{
+	// Unwrap the ring while copying, so that the oldest event ends up
+	// at the start.
+	std::vector<Event*> new_queue(queue.size() * 2);
+
+	for ( size_t i = 0; i < queue_len; ++i )
+		new_queue[i] = queue[(queue_head + i) & (queue.size() - 1)];
+
+	queue = std::move(new_queue);
+	queue_head = 0;
+	}
+
 void EventMgr::Dispatch(Event* event, bool no_remote)
 	{
 	current_src = event->Source();
@@ -144,15 +177,13 @@ void EventMgr::Drain()
 	// just one round to make it less likely to break existing scripts
 	// that expect the old behavior to trigger something quickly.
 
-	for ( int round = 0; head && round < 2; round++ )
+	for ( int round = 0; queue_len > 0 && round < 2; round++ )
 		{
-		Event* current = head;
-		head = nullptr;
-		tail = nullptr;
-
-		while ( current )
+		// Events that handlers queue during this round go into the
+		// next one.
+		for ( size_t n = queue_len; n > 0; --n )
 			{
-			Event* next = current->NextEvent();
+			Event* current = PopEvent();
 
 			current_src = current->Source();
 			current_aid = current->Analyzer();
@@ -161,10 +192,15 @@ void EventMgr::Drain()
 			Unref(current);
 
 			++event_mgr.num_events_dispatched;
-			current = next;
 			}
 		}
 
+	// QueueEvent() only fires the flare when the queue becomes non-empty,
+	// so events left for later would otherwise wait for some other source
+	// to wake up the main loop.
+	if ( queue_len > 0 )
+		queue_flare.Fire();
+
 	// Note: we might eventually need a general way to specify things to
 	// do after draining events.
 	draining = false;
@@ -176,16 +212,11 @@ void EventMgr::Drain()
 
 void EventMgr::Describe(ODesc* d) const
 	{
-	int n = 0;
-	Event* e;
-	for ( e = head; e; e = e->NextEvent() )
-		++n;
-
-	d->AddCount(n);
+	d->AddCount(queue_len);
 
-	for ( e = head; e; e = e->NextEvent() )
+	for ( size_t i = 0; i < queue_len; ++i )
 		{
-		e->Describe(d);
+		queue[(queue_head + i) & (queue.size() - 1)]->Describe(d);
 		d->NL();
 		}
 	}
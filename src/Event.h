@@ -4,6 +4,7 @@
 
 #include <tuple>
 #include <type_traits>
+#include <vector>
 
 #include "zeek/Flare.h"
 #include "zeek/IntrusivePtr.h"
@@ -28,9 +29,21 @@ public:
 	Event(const EventHandlerPtr& handler, zeek::Args args,
 	      util::detail::SourceID src = util::detail::SOURCE_LOCAL, analyzer::ID aid = 0,
 	      Obj* obj = nullptr, double ts = run_state::network_time);
+	~Event() override;
 
-	void SetNext(Event* n) { next_event = n; }
-	Event* NextEvent() const { return next_event; }
+	// Events are allocated from a dedicated ObjectPool.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
+	[[deprecated("Remove in v7.1 - The event queue no longer links events.")]] void
+	SetNext(Event* n)
+		{
+		}
+	[[deprecated("Remove in v7.1 - The event queue no longer links events.")]] Event*
+	NextEvent() const
+		{
+		return nullptr;
+		}
 
 	util::detail::SourceID Source() const { return src; }
 	analyzer::ID Analyzer() const { return aid; }
@@ -53,7 +66,6 @@ protected:
 	analyzer::ID aid;
 	double ts;
 	Obj* obj;
-	Event* next_event;
 	};
 
 class EventMgr final : public Obj, public iosource::IOSource
@@ -87,7 +99,7 @@ public:
 	std::enable_if_t<std::is_convertible_v<std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	Enqueue(const EventHandlerPtr& h, Args&&... args)
 		{
-		return Enqueue(h, zeek::Args{std::forward<Args>(args)...});
+		return Enqueue(h, MakeArgs(std::forward<Args>(args)...));
 		}
 
 	void Dispatch(Event* event, bool no_remote = false);
@@ -95,7 +107,7 @@ public:
 	void Drain();
 	bool IsDraining() const { return draining; }
 
-	bool HasEvents() const { return head != nullptr; }
+	bool HasEvents() const { return queue_len > 0; }
 
 	// Returns the source ID of last raised event.
 	util::detail::SourceID CurrentSource() const { return current_src; }
@@ -124,8 +136,24 @@ public:
 protected:
 	void QueueEvent(Event* event);
 
-	Event* head;
-	Event* tail;
+	// Removes the oldest event from the queue.
+	Event* PopEvent()
+		{
+		Event* e = queue[queue_head];
+		queue_head = (queue_head + 1) & (queue.size() - 1);
+		--queue_len;
+		return e;
+		}
+
+	// Doubles the queue's capacity.
+	void GrowQueue();
+
+	// The queued events, oldest first, in a ring buffer whose size is a
+	// power of two.
+	std::vector<Event*> queue;
+	size_t queue_head = 0;
+	size_t queue_len = 0;
+
 	util::detail::SourceID current_src;
 	analyzer::ID current_aid;
 	double current_ts;
@@ -1,5 +1,8 @@
 #include "zeek/EventHandler.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include "zeek/Desc.h"
 #include "zeek/Event.h"
 #include "zeek/Func.h"
@@ -111,11 +114,57 @@ void EventHandler::Call(Args* vl, bool no_remote, double ts)
 			}
 		}
 
-	if ( local )
+	if ( ! local )
+		return;
+
+	if ( BifConst::event_handler_timing )
+		TimedInvoke(vl);
+	else
 		// No try/catch here; we pass exceptions upstream.
 		local->Invoke(vl);
 	}
 
+void EventHandler::TimedInvoke(Args* vl)
+	{
+	if ( ! call_duration )
+		{
+		// From a microsecond up to a second, which is long enough to
+		// make a worker drop packets.
+		static const double bounds[] = {1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 0.1, 1.0};
+		static auto eh_duration_family = telemetry_mgr->HistogramFamily<double>(
+			"zeek", "event-handler-duration", {"name"}, bounds,
+			"Time spent running the given event handler", "seconds");
+
+		call_duration = eh_duration_family.GetOrAdd({{"name", name}});
+		}
+
+	using Clock = std::chrono::steady_clock;
+	auto start = Clock::now();
+
+	auto record = [this, start]()
+	{
+		double dt = std::chrono::duration<double>(Clock::now() - start).count();
+		++timed_calls;
+		total_time += dt;
+		max_time = std::max(max_time, dt);
+		call_duration->Observe(dt);
+	};
+
+	try
+		{
+		local->Invoke(vl);
+		}
+
+	catch ( ... )
+		{
+		// Handlers that fail still took their time.
+		record();
+		throw;
+		}
+
+	record();
+	}
+
 void EventHandler::NewEvent(Args* vl)
 	{
 	if ( ! new_event )
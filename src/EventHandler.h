@@ -10,6 +10,7 @@
 #include "zeek/ZeekArgs.h"
 #include "zeek/ZeekList.h"
 #include "zeek/telemetry/Counter.h"
+#include "zeek/telemetry/Histogram.h"
 
 namespace zeek
 	{
@@ -64,9 +65,19 @@ public:
 
 	uint64_t CallCount() const { return call_count ? call_count->Value() : 0; }
 
+	// Timing of the handler's invocations, collected while
+	// event_handler_timing is set.
+	uint64_t TimedCalls() const { return timed_calls; }
+	double TotalTime() const { return total_time; }
+	double MaxTime() const { return max_time; }
+	void ResetMaxTime() { max_time = 0.0; }
+
 private:
 	void NewEvent(zeek::Args* vl); // Raise new_event() meta event.
 
+	// Invokes the local handler and records how long it took.
+	void TimedInvoke(zeek::Args* vl);
+
 	std::string name;
 	FuncPtr local;
 	FuncTypePtr type;
@@ -77,6 +88,11 @@ private:
 
 	// Initialize this lazy, so we don't expose metrics for 0 values.
 	std::optional<zeek::telemetry::IntCounter> call_count;
+	std::optional<zeek::telemetry::DblHistogram> call_duration;
+
+	uint64_t timed_calls = 0;
+	double total_time = 0.0;
+	double max_time = 0.0;
 
 	std::unordered_set<std::string> auto_publish;
 	};
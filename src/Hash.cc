@@ -165,16 +165,14 @@ HashKey::HashKey(const String* s)
 HashKey::HashKey(const void* bytes, size_t arg_size)
 	{
 	size = write_size = arg_size;
-	key = CopyKey((char*)bytes, size);
-	is_our_dynamic = true;
+	SetKey((const char*)bytes, size);
 	}
 
 HashKey::HashKey(const void* arg_key, size_t arg_size, hash_t arg_hash)
 	{
 	size = write_size = arg_size;
 	hash = arg_hash;
-	key = CopyKey((char*)arg_key, size);
-	is_our_dynamic = true;
+	SetKey((const char*)arg_key, size);
 	}
 
 HashKey::HashKey(const void* arg_key, size_t arg_size, hash_t arg_hash, bool /* dont_copy */)
@@ -188,17 +186,7 @@ HashKey::HashKey(const HashKey& other) : HashKey(other.key, other.size, other.ha
 
 HashKey::HashKey(HashKey&& other) noexcept
 	{
-	hash = other.hash;
-	size = other.size;
-	write_size = other.write_size;
-	read_size = other.read_size;
-
-	is_our_dynamic = other.is_our_dynamic;
-	key = other.key;
-
-	other.size = 0;
-	other.is_our_dynamic = false;
-	other.key = nullptr;
+	MoveKey(other);
 	}
 
 HashKey::~HashKey()
@@ -233,6 +221,48 @@ void* HashKey::TakeKey()
 		return CopyKey(key, size);
 	}
 
+void HashKey::SetKey(const char* k, size_t s)
+	{
+	if ( s <= INLINE_KEY_SIZE )
+		{
+		memcpy(key_u.buf, k, s);
+		key = key_u.buf;
+		is_inline = true;
+		is_our_dynamic = false;
+		}
+	else
+		{
+		key = CopyKey(k, s);
+		is_inline = false;
+		is_our_dynamic = true;
+		}
+	}
+
+void HashKey::MoveKey(HashKey& other)
+	{
+	hash = other.hash;
+	size = other.size;
+	write_size = other.write_size;
+	read_size = other.read_size;
+
+	is_our_dynamic = other.is_our_dynamic;
+	is_inline = other.is_inline;
+
+	if ( other.key == reinterpret_cast<char*>(&other.key_u) )
+		{
+		// Inline buffers and scalars need to move along.
+		key_u = other.key_u;
+		key = reinterpret_cast<char*>(&key_u);
+		}
+	else
+		key = other.key;
+
+	other.size = 0;
+	other.is_our_dynamic = false;
+	other.is_inline = false;
+	other.key = nullptr;
+	}
+
 void HashKey::Describe(ODesc* d) const
 	{
 	char buf[64];
@@ -347,14 +377,22 @@ void HashKey::Reserve(const char* tag, size_t addl_size, size_t alignment)
 
 void HashKey::Allocate()
 	{
-	if ( key != nullptr && key != reinterpret_cast<char*>(&key_u) )
+	if ( IsAllocated() )
 		{
 		reporter->InternalWarning("usage error in HashKey::Allocate(): already allocated");
 		return;
 		}
 
-	is_our_dynamic = true;
-	key = reinterpret_cast<char*>(new double[size / sizeof(double) + 1]);
+	if ( size <= INLINE_KEY_SIZE )
+		{
+		key = key_u.buf;
+		is_inline = true;
+		}
+	else
+		{
+		is_our_dynamic = true;
+		key = reinterpret_cast<char*>(new double[size / sizeof(double) + 1]);
+		}
 
 	read_size = 0;
 	write_size = 0;
@@ -611,11 +649,10 @@ HashKey& HashKey::operator=(const HashKey& other)
 
 	hash = other.hash;
 	size = other.size;
-	is_our_dynamic = true;
 	write_size = other.write_size;
 	read_size = other.read_size;
 
-	key = CopyKey(other.key, other.size);
+	SetKey(other.key, other.size);
 
 	return *this;
 	}
@@ -625,20 +662,10 @@ HashKey& HashKey::operator=(HashKey&& other) noexcept
 	if ( this == &other )
 		return *this;
 
-	hash = other.hash;
-	size = other.size;
-	write_size = other.write_size;
-	read_size = other.read_size;
-
 	if ( is_our_dynamic && IsAllocated() )
 		delete[] key;
 
-	is_our_dynamic = other.is_our_dynamic;
-	key = other.key;
-
-	other.size = 0;
-	other.is_our_dynamic = false;
-	other.key = nullptr;
+	MoveKey(other);
 
 	return *this;
 	}
@@ -678,6 +705,60 @@ TEST_CASE("move assignment")
 	CHECK(h1 == h5);
 	}
 
+TEST_CASE("inline keys")
+	{
+	// Builds a key of the given size, with recognizable content.
+	auto make_key = [](size_t n)
+	{
+		HashKey hk;
+		hk.Reserve("int", sizeof(int), sizeof(int));
+		hk.Reserve("bytes", n - sizeof(int));
+		hk.Allocate();
+		hk.Write("int", static_cast<int>(n));
+
+		for ( size_t i = sizeof(int); i < n; ++i )
+			{
+			char c = static_cast<char>(i);
+			hk.Write("byte", &c, 1);
+			}
+
+		return hk;
+	};
+
+	for ( size_t n : {sizeof(int), size_t(48), HashKey::INLINE_KEY_SIZE,
+	                  HashKey::INLINE_KEY_SIZE + 1, size_t(200)} )
+		{
+		CAPTURE(n);
+
+		auto h1 = make_key(n);
+		CHECK(h1.IsAllocated());
+		CHECK(h1.IsInline() == (n <= HashKey::INLINE_KEY_SIZE));
+
+		// Copies and moves keep the key, at their own address.
+		HashKey h2{h1};
+		CHECK(h2 == h1);
+		CHECK(h2.Key() != h1.Key());
+		CHECK(h2.IsInline() == h1.IsInline());
+
+		HashKey h3{std::move(h2)};
+		CHECK(h3 == h1);
+
+		HashKey h4(12345);
+		h4 = std::move(h3);
+		CHECK(h4 == h1);
+
+		int i;
+		h4.ResetRead();
+		h4.Read("int", i);
+		CHECK(i == static_cast<int>(n));
+
+		// Handing the key over always yields a heap copy for inline keys.
+		auto k = static_cast<char*>(h4.TakeKey());
+		CHECK(memcmp(k, h1.Key(), n) == 0);
+		delete[] k;
+		}
+	}
+
 TEST_SUITE_END();
 
 	} // namespace zeek::detail
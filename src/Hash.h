@@ -232,6 +232,12 @@ constexpr int NUM_HASH_KEYS = HASH_KEY_STRING + 1;
 class HashKey
 	{
 public:
+	// Keys built through Reserve() and Allocate(), or copied from other
+	// keys, are kept inside the HashKey itself when they're no larger than
+	// this, and on the heap otherwise. That covers most composite table
+	// indices, such as [addr, port] and conn_id.
+	static constexpr size_t INLINE_KEY_SIZE = 64;
+
 	explicit HashKey() { key_u.u32 = 0; }
 	explicit HashKey(bool b);
 	explicit HashKey(int i);
@@ -277,21 +283,25 @@ public:
 
 	static hash_t HashBytes(const void* bytes, size_t size);
 
-	// A HashKey is "allocated" when the underlying key points somewhere
-	// other than our internal key_u union. This is almost like
-	// is_our_dynamic, but remains true also after TakeKey().
+	// A HashKey is "allocated" when the underlying key is a buffer rather
+	// than one of the scalars stored in our internal key_u union. This is
+	// almost like is_our_dynamic, but also holds for inline buffers, and
+	// remains true after TakeKey().
 	bool IsAllocated() const
 		{
-		return (key != nullptr && key != reinterpret_cast<const char*>(&key_u));
+		return (key != nullptr && (is_inline || key != reinterpret_cast<const char*>(&key_u)));
 		}
 
+	// Returns true if the key is a buffer held inline.
+	bool IsInline() const { return is_inline; }
+
 	// Buffer size reservation. Repeated calls to these methods
 	// incrementally build up the eventual buffer size to be allocated via
 	// Allocate().
 	template <typename T> void ReserveType(const char* tag) { Reserve(tag, sizeof(T), sizeof(T)); }
 	void Reserve(const char* tag, size_t addl_size, size_t alignment = 0);
 
-	// Allocates the reserved amount of memory
+	// Allocates the reserved amount of memory, inline if it fits.
 	void Allocate();
 
 	// Incremental writes into an allocated HashKey. The tags give context
@@ -361,6 +371,13 @@ public:
 protected:
 	char* CopyKey(const char* key, size_t size) const;
 
+	// Points the key at a copy of the given one, held inline if it fits.
+	// Any previous key must have been released already.
+	void SetKey(const char* key, size_t size);
+
+	// Takes over the key of another HashKey, which ends up empty.
+	void MoveKey(HashKey& other);
+
 	// Payload setters for types stored directly in the key_u union. These
 	// adjust the size and write_size markers to indicate a full buffer, and
 	// use the key_u union for storage.
@@ -379,12 +396,14 @@ protected:
 		uint32_t u32;
 		double d;
 		const void* p;
+		char buf[INLINE_KEY_SIZE];
 		} key_u;
 
 	char* key = nullptr;
 	mutable hash_t hash = 0;
 	size_t size = 0;
 	bool is_our_dynamic = false;
+	bool is_inline = false; // key points to key_u.buf
 	size_t write_size = 0;
 	mutable size_t read_size = 0;
 	};
@@ -341,15 +341,35 @@ public:
 	/**
 	 * Destructor.
 	 */
-	~IP_Hdr()
+	~IP_Hdr() { Release(); }
+
+	/**
+	 * Re-initializes the wrapper for a new IPv4 packet, releasing whatever
+	 * was held for the previous one. This allows reusing an instance
+	 * across packets instead of allocating a new one each time. The same
+	 * requirements as for the corresponding constructor apply.
+	 * @param arg_ip4 pointer to memory containing an IPv4 packet. It is
+	 * not owned by the instance.
+	 */
+	void Reset(const struct ip* arg_ip4)
 		{
-		delete ip6_hdrs;
+		Release();
+		ip4 = arg_ip4;
+		}
 
-		if ( del )
-			{
-			delete[](struct ip*) ip4;
-			delete[](struct ip6_hdr*) ip6;
-			}
+	/**
+	 * Re-initializes the wrapper for a new IPv6 packet, releasing whatever
+	 * was held for the previous one. The same requirements as for the
+	 * corresponding constructor apply.
+	 * @param arg_ip6 pointer to memory containing an IPv6 packet. It is
+	 * not owned by the instance.
+	 * @param len the packet's length in bytes.
+	 */
+	void Reset(const struct ip6_hdr* arg_ip6, uint64_t len)
+		{
+		Release();
+		ip6 = arg_ip6;
+		ip6_hdrs = new IPv6_Hdr_Chain(ip6, len);
 		}
 
 	/**
@@ -548,6 +568,23 @@ public:
 	bool Reassembled() const { return reassembled; }
 
 private:
+	void Release()
+		{
+		delete ip6_hdrs;
+
+		if ( del )
+			{
+			delete[](struct ip*) ip4;
+			delete[](struct ip6_hdr*) ip6;
+			}
+
+		ip4 = nullptr;
+		ip6 = nullptr;
+		ip6_hdrs = nullptr;
+		del = false;
+		reassembled = false;
+		}
+
 	const struct ip* ip4 = nullptr;
 	const struct ip6_hdr* ip6 = nullptr;
 	const IPv6_Hdr_Chain* ip6_hdrs = nullptr;
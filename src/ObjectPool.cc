@@ -0,0 +1,159 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/ObjectPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/telemetry/Manager.h"
+
+namespace zeek::detail
+	{
+
+// Default slab size, in bytes.
+static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+ObjectPool::ObjectPool(std::string arg_name, size_t arg_object_size, size_t arg_objects_per_slab)
+	: name(std::move(arg_name))
+	{
+	// Keep blocks aligned like the regular allocator does, and large
+	// enough to hold the free list link.
+	constexpr size_t align = alignof(std::max_align_t);
+	object_size = std::max(arg_object_size, sizeof(FreeBlock));
+	object_size = (object_size + align - 1) / align * align;
+
+	objects_per_slab = arg_objects_per_slab;
+
+	if ( objects_per_slab == 0 )
+		objects_per_slab = std::max(SLAB_SIZE / object_size, size_t(16));
+	}
+
+ObjectPool::~ObjectPool()
+	{
+	for ( auto* slab : slabs )
+		::operator delete(slab);
+	}
+
+void ObjectPool::AddSlab()
+	{
+	auto* slab = static_cast<char*>(::operator new(object_size * objects_per_slab));
+	slabs.push_back(slab);
+
+	// Chain the new blocks up in address order, so that consecutive
+	// allocations are adjacent.
+	for ( size_t i = objects_per_slab; i > 0; --i )
+		{
+		auto* b = reinterpret_cast<FreeBlock*>(slab + (i - 1) * object_size);
+		b->next = free_list;
+		free_list = b;
+		}
+
+	UpdateMetrics();
+	}
+
+void ObjectPool::UpdateMetrics()
+	{
+	ops_since_update = 0;
+
+	// Pools may be used before the telemetry manager exists, e.g. while
+	// parsing scripts, and after it's gone during shutdown.
+	if ( ! telemetry_mgr )
+		return;
+
+	if ( ! in_use_gauge )
+		{
+		auto in_use_family = telemetry_mgr->GaugeFamily(
+			"zeek", "object-pool-used-objects", {"pool"},
+			"Number of objects handed out by Zeek's internal object pools");
+		auto capacity_family = telemetry_mgr->GaugeFamily(
+			"zeek", "object-pool-capacity-objects", {"pool"},
+			"Number of objects Zeek's internal object pools have memory for");
+
+		in_use_gauge = in_use_family.GetOrAdd({{"pool", name}});
+		capacity_gauge = capacity_family.GetOrAdd({{"pool", name}});
+		}
+
+	// Pools may share gauges, so only ever apply our own changes.
+	int64_t cur_in_use = static_cast<int64_t>(in_use);
+	int64_t cur_capacity = static_cast<int64_t>(Capacity());
+
+	in_use_gauge->Inc(cur_in_use - reported_in_use);
+	capacity_gauge->Inc(cur_capacity - reported_capacity);
+
+	reported_in_use = cur_in_use;
+	reported_capacity = cur_capacity;
+	}
+
+SizeClassPool::SizeClassPool(std::string arg_name, size_t arg_max_size, size_t arg_granularity)
+	: name(std::move(arg_name)), max_size(arg_max_size), granularity(arg_granularity)
+	{
+	pools.resize((max_size + granularity - 1) / granularity);
+	}
+
+SizeClassPool::~SizeClassPool() = default;
+
+	} // namespace zeek::detail
+
+TEST_CASE("object pool")
+	{
+	using zeek::detail::ObjectPool;
+
+	ObjectPool pool("test", 40, 8);
+	CHECK(pool.ObjectSize() % alignof(std::max_align_t) == 0);
+	CHECK(pool.ObjectSize() >= 40);
+
+	std::set<void*> ptrs;
+
+	for ( int i = 0; i < 20; ++i )
+		{
+		void* p = pool.Allocate(40);
+		memset(p, 0xab, 40);
+		ptrs.insert(p);
+		}
+
+	CHECK(ptrs.size() == 20);
+	CHECK(pool.ObjectsInUse() == 20);
+	CHECK(pool.Capacity() == 24);
+
+	for ( auto* p : ptrs )
+		pool.Free(p, 40);
+
+	CHECK(pool.ObjectsInUse() == 0);
+
+	// Freed blocks get reused before the pool grows.
+	void* p = pool.Allocate(40);
+	CHECK(ptrs.count(p) == 1);
+	CHECK(pool.Capacity() == 24);
+	pool.Free(p, 40);
+
+	// Larger requests bypass the pool.
+	void* big = pool.Allocate(1000);
+	CHECK(pool.ObjectsInUse() == 0);
+	pool.Free(big, 1000);
+	}
+
+TEST_CASE("size class pool")
+	{
+	zeek::detail::SizeClassPool pools("test", 256, 64);
+
+	void* a = pools.Allocate(10);
+	void* b = pools.Allocate(64);
+	void* c = pools.Allocate(65);
+	void* d = pools.Allocate(4096);
+
+	memset(a, 1, 10);
+	memset(b, 2, 64);
+	memset(c, 3, 65);
+	memset(d, 4, 4096);
+
+	pools.Free(a, 10);
+	pools.Free(b, 64);
+	pools.Free(c, 65);
+	pools.Free(d, 4096);
+
+	// The most recently freed block of a size class comes back first.
+	CHECK(pools.Allocate(1) == b);
+	pools.Free(b, 1);
+	}
@@ -0,0 +1,211 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "zeek/telemetry/Gauge.h"
+
+namespace zeek::detail
+	{
+
+/**
+ * A pool of fixed-size memory blocks for objects that get created and
+ * destroyed at high rates, such as connections. Memory is taken from the
+ * system in slabs of many objects and kept on a free list once released,
+ * so that allocation and deallocation are a couple of pointer operations
+ * and objects of one type stay close together in memory.
+ *
+ * Classes use a pool by defining their own operator new and operator
+ * delete in terms of Allocate() and Free(). The size-aware form of
+ * operator delete must be used: blocks larger than the pool's object size,
+ * as requested for derived classes, are passed through to the regular
+ * allocator.
+ *
+ * Slabs are never handed back to the system while the pool exists. Pools
+ * are not thread-safe; they are meant for objects owned by the main thread.
+ *
+ * The number of objects in use and the pool's capacity are exported as
+ * telemetry gauges, labeled with the pool's name.
+ */
+class ObjectPool
+	{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param name The name of the pool, for telemetry.
+	 * @param object_size The size of the objects handed out.
+	 * @param objects_per_slab The number of objects allocated from the
+	 * system at a time. If zero, slabs are sized to about 64KB.
+	 */
+	ObjectPool(std::string name, size_t object_size, size_t objects_per_slab = 0);
+	~ObjectPool();
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	/**
+	 * Returns memory for an object.
+	 *
+	 * @param size The size of the object. If it's larger than the pool's
+	 * object size, the memory comes from the regular allocator.
+	 */
+	void* Allocate(size_t size)
+		{
+		if ( size > object_size )
+			return ::operator new(size);
+
+		if ( ! free_list )
+			AddSlab();
+
+		FreeBlock* b = free_list;
+		free_list = b->next;
+		++in_use;
+		Touch();
+
+		return b;
+		}
+
+	/**
+	 * Releases memory returned by Allocate().
+	 *
+	 * @param ptr The memory. Null is ignored.
+	 * @param size The size that was passed to Allocate().
+	 */
+	void Free(void* ptr, size_t size)
+		{
+		if ( ! ptr )
+			return;
+
+		if ( size > object_size )
+			{
+			::operator delete(ptr);
+			return;
+			}
+
+		auto* b = static_cast<FreeBlock*>(ptr);
+		b->next = free_list;
+		free_list = b;
+		--in_use;
+		Touch();
+		}
+
+	/**
+	 * Returns the pool's name.
+	 */
+	const std::string& Name() const { return name; }
+
+	/**
+	 * Returns the size of the blocks handed out.
+	 */
+	size_t ObjectSize() const { return object_size; }
+
+	/**
+	 * Returns the number of blocks currently handed out.
+	 */
+	size_t ObjectsInUse() const { return in_use; }
+
+	/**
+	 * Returns the total number of blocks in the pool's slabs.
+	 */
+	size_t Capacity() const { return slabs.size() * objects_per_slab; }
+
+	/**
+	 * Pushes the current counts to the telemetry gauges. This happens
+	 * regularly by itself as the pool gets used.
+	 */
+	void UpdateMetrics();
+
+private:
+	struct FreeBlock
+		{
+		FreeBlock* next;
+		};
+
+	// Counts an operation and updates the metrics every so often.
+	void Touch()
+		{
+		if ( ++ops_since_update >= METRICS_INTERVAL )
+			UpdateMetrics();
+		}
+
+	void AddSlab();
+
+	static constexpr unsigned int METRICS_INTERVAL = 256;
+
+	std::string name;
+	size_t object_size;
+	size_t objects_per_slab;
+
+	FreeBlock* free_list = nullptr;
+	std::vector<void*> slabs;
+	size_t in_use = 0;
+
+	unsigned int ops_since_update = 0;
+	std::optional<telemetry::IntGauge> in_use_gauge;
+	std::optional<telemetry::IntGauge> capacity_gauge;
+	int64_t reported_in_use = 0;
+	int64_t reported_capacity = 0;
+	};
+
+/**
+ * A set of ObjectPools for objects of varying sizes, such as the different
+ * subclasses of a common base class. Each allocation is served by the pool
+ * for its size, rounded up to a multiple of a granularity. Allocations above
+ * a maximum size go to the regular allocator.
+ *
+ * All of the pools report to telemetry under the set's name.
+ */
+class SizeClassPool
+	{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param name The name of the pools, for telemetry.
+	 * @param max_size The largest size served from a pool.
+	 * @param granularity The difference in size between pools.
+	 */
+	SizeClassPool(std::string name, size_t max_size, size_t granularity = 64);
+	~SizeClassPool();
+
+	void* Allocate(size_t size)
+		{
+		if ( size > max_size || size == 0 )
+			return ::operator new(size);
+
+		return GetPool(size).Allocate(size);
+		}
+
+	void Free(void* ptr, size_t size)
+		{
+		if ( size > max_size || size == 0 )
+			::operator delete(ptr);
+		else
+			GetPool(size).Free(ptr, size);
+		}
+
+private:
+	ObjectPool& GetPool(size_t size)
+		{
+		size_t idx = (size - 1) / granularity;
+
+		if ( ! pools[idx] )
+			pools[idx] = std::make_unique<ObjectPool>(name, (idx + 1) * granularity);
+
+		return *pools[idx];
+		}
+
+	std::string name;
+	size_t max_size;
+	size_t granularity;
+	std::vector<std::unique_ptr<ObjectPool>> pools;
+	};
+
+	} // namespace zeek::detail
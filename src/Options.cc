@@ -196,6 +196,8 @@ static void print_analysis_help()
 	fprintf(stderr, "    help	print this list\n");
 	fprintf(stderr, "    report-uncompilable	print names of functions that can't be compiled\n");
 	fprintf(stderr, "\n  primarily for developers:\n");
+	fprintf(stderr, "    count-ZAM-seqs	count executed sequences of ZAM operations (written to "
+	                "$ZEEK_ZAM_SEQ_FILE, or zam-seqs.txt); implies -O ZAM\n");
 	fprintf(stderr, "    dump-uds	dump use-defs to stdout; implies xform\n");
 	fprintf(stderr, "    dump-xform	dump transformed scripts to stdout; implies xform\n");
 	fprintf(stderr, "    dump-ZAM	dump generated ZAM code; implies gen-ZAM-code\n");
@@ -208,6 +210,8 @@ static void print_analysis_help()
 	fprintf(stderr,
 	        "    profile-ZAM	generate to stdout a ZAM execution profile; implies -O ZAM\n");
 	fprintf(stderr, "    report-recursive	report on recursive functions and exit\n");
+	fprintf(stderr, "    sample-ZAM	sample ZAM execution into a flame graph profile (written to "
+	                "$ZEEK_ZAM_SAMPLE_FILE, or zam-samples.folded); implies -O ZAM\n");
 	fprintf(stderr, "    xform	transform scripts to \"reduced\" form\n");
 
 	fprintf(stderr, "\n--optimize options when generating C++:\n");
@@ -239,7 +243,9 @@ static void set_analysis_option(const char* opt, Options& opts)
 		exit(0);
 		}
 
-	if ( util::streq(opt, "dump-uds") )
+	if ( util::streq(opt, "count-ZAM-seqs") )
+		a_o.count_ZAM_seqs = true;
+	else if ( util::streq(opt, "dump-uds") )
 		a_o.activate = a_o.dump_uds = true;
 	else if ( util::streq(opt, "dump-xform") )
 		a_o.activate = a_o.dump_xform = true;
@@ -269,6 +275,8 @@ static void set_analysis_option(const char* opt, Options& opts)
 		a_o.inliner = a_o.report_recursive = true;
 	else if ( util::streq(opt, "report-uncompilable") )
 		a_o.report_uncompilable = true;
+	else if ( util::streq(opt, "sample-ZAM") )
+		a_o.sample_ZAM = true;
 	else if ( util::streq(opt, "use-C++") )
 		a_o.use_CPP = true;
 	else if ( util::streq(opt, "xform") )
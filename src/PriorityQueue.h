@@ -25,10 +25,15 @@ public:
 
 	void MinimizeTime() { time = -HUGE_VAL; }
 
+	// The bucket the element is stored in when queued in a TimerWheel.
+	int Bucket() const { return bucket; }
+	void SetBucket(int b) { bucket = b; }
+
 protected:
 	PQ_Element() = default;
 	double time = 0.0;
 	int offset = -1;
+	int bucket = -1;
 	};
 
 class PriorityQueue
@@ -58,6 +63,31 @@ public:
 	// memory to add the element), true on success.
 	bool Add(PQ_Element* e);
 
+	// Removes and deletes all elements for which pred returns true.
+	// Returns the number of elements deleted.
+	template <typename Pred> int RemoveIf(Pred pred)
+		{
+		int n = 0;
+
+		for ( int i = 0; i < heap_size; ++i )
+			{
+			PQ_Element* e = heap[i];
+
+			if ( pred(e) )
+				delete e;
+			else
+				SetElement(n++, e);
+			}
+
+		int removed = heap_size - n;
+		heap_size = n;
+
+		for ( int i = heap_size - 1; i >= 0; --i )
+			BubbleDown(i);
+
+		return removed;
+		}
+
 	int Size() const { return heap_size; }
 	int PeakSize() const { return peak_heap_size; }
 	uint64_t CumulativeNum() const { return cumulative_num; }
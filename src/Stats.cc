@@ -171,8 +171,11 @@ void ProfileLogger::Log()
 		                      run_state::network_time, stats.matchers, stats.nfa_states,
 		                      stats.dfa_states, stats.computed, stats.mem / 1024));
 		}
-	file->Write(util::fmt("%.06f Timers: current=%zu max=%zu lag=%.2fs\n", run_state::network_time,
-	                      timer_mgr->Size(), timer_mgr->PeakSize(),
+	// The current timers include the canceled ones that haven't been purged yet, as do the
+	// per-type counts below.
+	file->Write(util::fmt("%.06f Timers: current=%zu canceled=%zu max=%zu lag=%.2fs\n",
+	                      run_state::network_time, timer_mgr->Size(), timer_mgr->NumCanceled(),
+	                      timer_mgr->PeakSize(),
 	                      run_state::network_time - timer_mgr->LastTimestamp()));
 
 	DNS_Mgr::Stats dstats;
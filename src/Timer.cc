@@ -4,6 +4,7 @@
 
 #include "zeek/zeek-config.h"
 
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/Desc.h"
 #include "zeek/NetVar.h"
 #include "zeek/RunState.h"
@@ -57,6 +58,19 @@ const char* timer_type_to_string(TimerType type)
 	return TimerNames[type];
 	}
 
+// Canceled timers get purged from the queue once there are at least this
+// many of them and they make up more than half of it.
+static constexpr size_t MIN_CANCELED_FOR_PURGE = 10000;
+
+Timer::~Timer()
+	{
+	if ( group )
+		{
+		group->TimerDeleted();
+		Unref(group);
+		}
+	}
+
 void Timer::Describe(ODesc* d) const
 	{
 	d->Add(TimerNames[type]);
@@ -105,6 +119,25 @@ void TimerMgr::InitPostScript()
 		iosource_mgr->Register(this, true);
 
 	dispatch_all_expired = zeek::detail::max_timer_expires == 0;
+
+	if ( BifConst::use_timer_wheel && ! wheel )
+		{
+		double resolution = BifConst::timer_wheel_resolution;
+
+		if ( resolution <= 0.0 )
+			{
+			reporter->Error("timer_wheel_resolution must be positive, using 1 msec");
+			resolution = 0.001;
+			}
+
+		wheel = std::make_unique<TimerWheel>(resolution);
+
+		// Move over any timers set up while parsing scripts.
+		while ( auto* timer = q->Remove() )
+			wheel->Add(timer);
+
+		q.reset();
+		}
 	}
 
 void TimerMgr::Add(Timer* timer)
@@ -115,7 +148,9 @@ void TimerMgr::Add(Timer* timer)
 	// Add the timer even if it's already expired - that way, if
 	// multiple already-added timers are added, they'll still
 	// execute in sorted order.
-	if ( ! q->Add(timer) )
+	bool added = wheel ? wheel->Add(timer) : q->Add(timer);
+
+	if ( ! added )
 		reporter->InternalError("out of memory");
 
 	++current_timers[timer->Type()];
@@ -124,8 +159,10 @@ void TimerMgr::Add(Timer* timer)
 void TimerMgr::Expire()
 	{
 	Timer* timer;
-	while ( (timer = Remove()) )
+	while ( (timer = Top()) )
 		{
+		(void)Remove();
+
 		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)", timer_type_to_string(timer->Type()), timer);
 		timer->Dispatch(t, true);
 		--current_timers[timer->Type()];
@@ -150,6 +187,12 @@ int TimerMgr::DoAdvance(double new_t, int max_expire)
 
 		DBG_LOG(DBG_TM, "Dispatching timer %s (%p)", timer_type_to_string(timer->Type()), timer);
 		timer->Dispatch(new_t, false);
+
+		// The dispatch may have canceled the timer's own group, which
+		// counted it as queued.
+		if ( timer->IsCanceled() && num_canceled > 0 )
+			--num_canceled;
+
 		delete timer;
 
 		timer = Top();
@@ -160,9 +203,16 @@ int TimerMgr::DoAdvance(double new_t, int max_expire)
 
 void TimerMgr::Remove(Timer* timer)
 	{
-	if ( ! q->Remove(timer) )
+	DBG_LOG(DBG_TM, "Canceling timer %s (%p)", timer_type_to_string(timer->Type()), timer);
+
+	PQ_Element* removed = wheel ? wheel->Remove(timer) : q->Remove(timer);
+
+	if ( ! removed )
 		reporter->InternalError("asked to remove a missing timer");
 
+	if ( timer->IsCanceled() && num_canceled > 0 )
+		--num_canceled;
+
 	--current_timers[timer->Type()];
 	delete timer;
 	}
@@ -178,12 +228,114 @@ double TimerMgr::GetNextTimeout()
 
 Timer* TimerMgr::Remove()
 	{
-	return (Timer*)q->Remove();
+	return (Timer*)(wheel ? wheel->Remove() : q->Remove());
 	}
 
 Timer* TimerMgr::Top()
 	{
-	return (Timer*)q->Top();
+	Timer* top = (Timer*)(wheel ? wheel->Top() : q->Top());
+
+	// Timers of canceled groups get dropped as they come up.
+	while ( top && top->IsCanceled() )
+		{
+		(void)Remove();
+		--current_timers[top->Type()];
+
+		if ( num_canceled > 0 )
+			--num_canceled;
+
+		delete top;
+		top = (Timer*)(wheel ? wheel->Top() : q->Top());
+		}
+
+	return top;
+	}
+
+void TimerMgr::Cancel(TimerGroup* group)
+	{
+	if ( group->IsCanceled() )
+		return;
+
+	DBG_LOG(DBG_TM, "Canceling timer group %p with %d timers", group, group->NumTimers());
+
+	num_canceled += group->NumTimers();
+	group->Cancel();
+
+	if ( num_canceled >= MIN_CANCELED_FOR_PURGE && num_canceled > Size() / 2 )
+		PurgeCanceled();
+	}
+
+void TimerMgr::PurgeCanceled()
+	{
+	auto canceled = [](PQ_Element* e)
+	{
+		auto* timer = static_cast<Timer*>(e);
+
+		if ( ! timer->IsCanceled() )
+			return false;
+
+		--current_timers[timer->Type()];
+		return true;
+	};
+
+	int purged = wheel ? wheel->RemoveIf(canceled) : q->RemoveIf(canceled);
+	DBG_LOG(DBG_TM, "Purged %d canceled timers", purged);
+
+	num_canceled = 0;
 	}
 
 	} // namespace zeek::detail
+
+TEST_CASE("timer group")
+	{
+	using namespace zeek::detail;
+
+	struct TestTimer final : public Timer
+		{
+		explicit TestTimer(double t) : Timer(t, TIMER_SCHEDULE) { }
+		void Dispatch(double, bool) override { }
+		};
+
+	// A manager of its own keeps the global one's counts out of this.
+	// The IO source manager takes ownership of it, if there's one.
+	auto* mgr = new TimerMgr();
+	auto* owner = new zeek::Obj();
+	auto* group = new TimerGroup(owner);
+
+	for ( int i = 0; i < 3; ++i )
+		{
+		auto* timer = new TestTimer(i);
+		timer->SetGroup(group);
+		mgr->Add(timer);
+		}
+
+	auto* other = new TestTimer(10);
+	mgr->Add(other);
+
+	// The group holds a single reference to its owner while it has timers.
+	CHECK(owner->RefCnt() == 2);
+	CHECK(group->NumTimers() == 3);
+
+	// Canceling releases the owner without touching the timers, which
+	// keep counting as queued.
+	mgr->Cancel(group);
+	CHECK(group->IsCanceled());
+	CHECK(owner->RefCnt() == 1);
+	CHECK(mgr->Size() == 4);
+	CHECK(mgr->NumCanceled() == 3);
+
+	// Looking at the next timer drops the canceled ones before it.
+	CHECK(mgr->GetNextTimeout() >= 0.0);
+	CHECK(mgr->Size() == 1);
+	CHECK(mgr->NumCanceled() == 0);
+	CHECK(group->NumTimers() == 0);
+
+	mgr->Cancel(other);
+	CHECK(mgr->Size() == 0);
+
+	zeek::Unref(group);
+	zeek::Unref(owner);
+
+	if ( ! zeek::iosource_mgr )
+		delete mgr;
+	}
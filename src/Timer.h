@@ -5,7 +5,9 @@
 #include <cstdint>
 #include <memory>
 
+#include "zeek/Obj.h"
 #include "zeek/PriorityQueue.h"
+#include "zeek/TimerWheel.h"
 #include "zeek/iosource/IOSource.h"
 
 namespace zeek
@@ -57,11 +59,71 @@ constexpr int NUM_TIMER_TYPES = int(TIMER_UNKNOWN_PROTOCOL_EXPIRE) + 1;
 
 extern const char* timer_type_to_string(TimerType type);
 
+/**
+ * A set of timers that get canceled together, such as all the timers of a
+ * session. Canceling a group is a single operation that doesn't touch its
+ * timers: they stay queued, and the TimerMgr deletes them without
+ * dispatching once they come up, or earlier if canceled timers pile up.
+ *
+ * While a group has timers and isn't canceled, it holds a reference to its
+ * owner, so that the owner stays around for the timers to use. Each timer
+ * holds a reference to its group.
+ */
+class TimerGroup final : public Obj
+	{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param owner The object the group's timers operate on.
+	 */
+	explicit TimerGroup(Obj* arg_owner) : owner(arg_owner) { }
+
+	/**
+	 * Returns true if the group has been canceled via TimerMgr::Cancel().
+	 */
+	bool IsCanceled() const { return canceled; }
+
+	/**
+	 * Returns the number of timers in the group that haven't been
+	 * deleted yet.
+	 */
+	int NumTimers() const { return num_timers; }
+
+private:
+	friend class Timer;
+	friend class TimerMgr;
+
+	void TimerAdded()
+		{
+		if ( num_timers++ == 0 && ! canceled )
+			Ref(owner);
+		}
+
+	void TimerDeleted()
+		{
+		if ( --num_timers == 0 && ! canceled )
+			Unref(owner);
+		}
+
+	void Cancel()
+		{
+		canceled = true;
+
+		if ( num_timers > 0 )
+			Unref(owner);
+		}
+
+	Obj* owner;
+	int num_timers = 0;
+	bool canceled = false;
+	};
+
 class Timer : public PQ_Element
 	{
 public:
 	Timer(double t, TimerType arg_type) : PQ_Element(t), type(arg_type) { }
-	~Timer() override { }
+	~Timer() override;
 
 	TimerType Type() const { return type; }
 
@@ -72,8 +134,27 @@ public:
 
 	void Describe(ODesc* d) const;
 
+	/**
+	 * Puts the timer into a group. This must happen before the timer
+	 * gets added to the TimerMgr, and only once.
+	 */
+	void SetGroup(TimerGroup* arg_group)
+		{
+		group = arg_group;
+		Ref(group);
+		group->TimerAdded();
+		}
+
+	/**
+	 * Returns true if the timer's group has been canceled. Such timers
+	 * don't get dispatched anymore, and the objects they refer to may
+	 * be gone.
+	 */
+	bool IsCanceled() const { return group && group->IsCanceled(); }
+
 protected:
 	TimerType type{};
+	TimerGroup* group = nullptr;
 	};
 
 class TimerMgr final : public iosource::IOSource
@@ -115,11 +196,38 @@ public:
 	 */
 	void Cancel(Timer* timer) { Remove(timer); }
 
+	/**
+	 * Cancels all timers of a group in one go. The timers get deleted
+	 * later, without being dispatched, and count toward Size() until
+	 * then.
+	 *
+	 * @param group the group to cancel
+	 */
+	void Cancel(TimerGroup* group);
+
 	double Time() const { return t ? t : 1; } // 1 > 0
 
-	size_t Size() const { return q->Size(); }
-	size_t PeakSize() const { return q->PeakSize(); }
-	size_t CumulativeNum() const { return q->CumulativeNum(); }
+	/**
+	 * Returns the number of queued timers. This includes the timers of
+	 * canceled groups until they get purged, see NumCanceled(). The same
+	 * goes for the per-type counts of CurrentTimers().
+	 */
+	size_t Size() const { return wheel ? wheel->Size() : q->Size(); }
+
+	/**
+	 * Returns an estimate of the number of queued timers of canceled
+	 * groups.
+	 */
+	size_t NumCanceled() const { return num_canceled; }
+
+	size_t PeakSize() const { return wheel ? wheel->PeakSize() : q->PeakSize(); }
+	size_t CumulativeNum() const { return wheel ? wheel->CumulativeNum() : q->CumulativeNum(); }
+
+	/**
+	 * Returns true if the manager keeps its timers in a TimerWheel
+	 * rather than a PriorityQueue.
+	 */
+	bool UsesTimerWheel() const { return wheel != nullptr; }
 
 	double LastTimestamp() const { return last_timestamp; }
 
@@ -137,7 +245,9 @@ public:
 
 	/**
 	 * Performs some extra initialization on a timer manager. This shouldn't
-	 * need to be called for managers other than the global one.
+	 * need to be called for managers other than the global one. If
+	 * use_timer_wheel is set, this switches the manager over to a
+	 * TimerWheel.
 	 */
 	void InitPostScript();
 
@@ -145,6 +255,9 @@ private:
 	int DoAdvance(double t, int max_expire);
 	void Remove(Timer* timer);
 
+	// Deletes all timers of canceled groups.
+	void PurgeCanceled();
+
 	Timer* Remove();
 	Timer* Top();
 
@@ -160,8 +273,14 @@ private:
 	size_t peak_size = 0;
 	size_t cumulative_num = 0;
 
+	// An estimate of the number of queued timers of canceled groups.
+	size_t num_canceled = 0;
+
 	static unsigned int current_timers[NUM_TIMER_TYPES];
+
+	// Exactly one of these holds the timers.
 	std::unique_ptr<PriorityQueue> q;
+	std::unique_ptr<TimerWheel> wheel;
 	};
 
 extern TimerMgr* timer_mgr;
@@ -0,0 +1,568 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/TimerWheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::detail
+	{
+
+// Times beyond this many ticks all map to the same tick.
+static constexpr uint64_t MAX_TICK = uint64_t(1) << 62;
+
+// The wheel gets rebuilt once more than this many elements, or an eighth
+// of all elements if that's more, were added for times before the current
+// tick.
+static constexpr int MIN_EARLY_FOR_REWIND = 256;
+
+// Returns the index of the lowest set bit. "bits" must not be 0.
+static inline int lowest_bit(uint64_t bits)
+	{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(bits);
+#endif
+	}
+
+// Returns the index of the highest set bit. "bits" must not be 0.
+static inline int highest_bit(uint64_t bits)
+	{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+	}
+
+TimerWheel::TimerWheel(double arg_resolution) : resolution(arg_resolution) { }
+
+TimerWheel::~TimerWheel()
+	{
+	// The current heap deletes its own elements.
+	for ( auto& b : buckets )
+		for ( auto* e : b )
+			delete e;
+	}
+
+uint64_t TimerWheel::Tick(double t) const
+	{
+	if ( ! (t > 0.0) )
+		return 0;
+
+	double ticks = t / resolution;
+
+	if ( ticks >= double(MAX_TICK) )
+		return MAX_TICK;
+
+	return uint64_t(ticks);
+	}
+
+bool TimerWheel::Add(PQ_Element* e)
+	{
+	// An empty wheel can start turning anywhere, which keeps the first
+	// element out of the overflow list.
+	uint64_t tick = Tick(e->Time());
+
+	if ( size == 0 )
+		cursor = tick;
+
+	Place(e);
+
+	++cumulative_num;
+
+	if ( ++size > peak_size )
+		peak_size = size;
+
+	if ( tick < cursor && ++num_early > std::max(MIN_EARLY_FOR_REWIND, size / 8) )
+		Rewind();
+
+	return true;
+	}
+
+PQ_Element* TimerWheel::Remove()
+	{
+	PQ_Element* top = Top();
+
+	if ( ! top )
+		return nullptr;
+
+	current.Remove();
+	--size;
+
+	top->SetBucket(-1);
+	top->SetOffset(-1);
+	return top;
+	}
+
+PQ_Element* TimerWheel::Remove(PQ_Element* e)
+	{
+	int b = e->Bucket();
+
+	if ( b < 0 )
+		return nullptr; // not in the wheel
+
+	if ( b == CURRENT_BUCKET )
+		current.Remove(e);
+	else
+		{
+		auto& bucket = buckets[b];
+		PQ_Element* last = bucket.back();
+		bucket[e->Offset()] = last;
+		last->SetOffset(e->Offset());
+		bucket.pop_back();
+
+		if ( bucket.empty() && b < OVERFLOW_BUCKET )
+			occupied[b / SLOTS][(b % SLOTS) / 64] &= ~(uint64_t(1) << (b % 64));
+		}
+
+	--size;
+
+	e->SetBucket(-1);
+	e->SetOffset(-1);
+	return e;
+	}
+
+void TimerWheel::Place(PQ_Element* e)
+	{
+	uint64_t tick = Tick(e->Time());
+
+	if ( tick <= cursor )
+		{
+		AddToCurrent(e);
+		return;
+		}
+
+	// The element goes into the lowest level whose range of slots
+	// covers the first bit in which its tick differs from the current
+	// one. Its slot there always comes after the current one.
+	int high_bit = highest_bit(tick ^ cursor);
+	int level = high_bit / LEVEL_BITS;
+
+	if ( level >= LEVELS )
+		{
+		AddToBucket(OVERFLOW_BUCKET, e);
+		return;
+		}
+
+	int slot = (tick >> (level * LEVEL_BITS)) & (SLOTS - 1);
+	AddToBucket(level * SLOTS + slot, e);
+	}
+
+void TimerWheel::AddToBucket(int b, PQ_Element* e)
+	{
+	auto& bucket = buckets[b];
+
+	e->SetBucket(b);
+	e->SetOffset(bucket.size());
+	bucket.push_back(e);
+
+	if ( b < OVERFLOW_BUCKET )
+		occupied[b / SLOTS][(b % SLOTS) / 64] |= uint64_t(1) << (b % 64);
+	}
+
+void TimerWheel::AddToCurrent(PQ_Element* e)
+	{
+	e->SetBucket(CURRENT_BUCKET);
+	current.Add(e);
+	}
+
+int TimerWheel::NextOccupied(int level, int slot) const
+	{
+	for ( int word = slot / 64; word < SLOTS / 64; ++word )
+		{
+		uint64_t bits = occupied[level][word];
+
+		if ( word == slot / 64 )
+			bits &= ~uint64_t(0) << (slot % 64);
+
+		if ( bits )
+			return word * 64 + lowest_bit(bits);
+		}
+
+	return -1;
+	}
+
+bool TimerWheel::LoadNext()
+	{
+	num_early = 0;
+
+	while ( size > 0 )
+		{
+		bool cascaded = false;
+
+		for ( int level = 0; level < LEVELS; ++level )
+			{
+			int shift = level * LEVEL_BITS;
+			int slot = NextOccupied(level, int((cursor >> shift) & (SLOTS - 1)) + 1);
+
+			if ( slot < 0 )
+				continue;
+
+			// Turn to the start of the slot's range. All lower levels
+			// are empty at this point.
+			int high_shift = shift + LEVEL_BITS;
+			cursor = ((cursor >> high_shift) << high_shift) | (uint64_t(slot) << shift);
+
+			int b = level * SLOTS + slot;
+			std::vector<PQ_Element*> elements;
+			elements.swap(buckets[b]);
+			occupied[level][slot / 64] &= ~(uint64_t(1) << (slot % 64));
+
+			// Spread the slot's elements out over the lower levels. For
+			// level 0, they all go into the current heap.
+			for ( auto* e : elements )
+				Place(e);
+
+			cascaded = true;
+			break;
+			}
+
+		if ( current.Size() > 0 )
+			return true;
+
+		if ( cascaded )
+			continue;
+
+		// Only the overflow list is left. Turn straight to its earliest
+		// element and place the others relative to that.
+		std::vector<PQ_Element*> elements;
+		elements.swap(buckets[OVERFLOW_BUCKET]);
+
+		if ( elements.empty() )
+			break;
+
+		cursor = MAX_TICK;
+
+		for ( auto* e : elements )
+			cursor = std::min(cursor, Tick(e->Time()));
+
+		for ( auto* e : elements )
+			Place(e);
+		}
+
+	return current.Size() > 0;
+	}
+
+void TimerWheel::Rewind()
+	{
+	std::vector<PQ_Element*> elements;
+	elements.reserve(size);
+
+	// The current heap's top is the earliest element overall.
+	cursor = Tick(current.Top()->Time());
+
+	while ( auto* e = current.Remove() )
+		elements.push_back(e);
+
+	for ( auto& b : buckets )
+		{
+		elements.insert(elements.end(), b.begin(), b.end());
+		b.clear();
+		}
+
+	memset(occupied, 0, sizeof(occupied));
+
+	for ( auto* e : elements )
+		Place(e);
+
+	num_early = 0;
+	}
+
+	} // namespace zeek::detail
+
+TEST_CASE("timer wheel bit scans")
+	{
+	CHECK(lowest_bit(1) == 0);
+	CHECK(highest_bit(1) == 0);
+	CHECK(lowest_bit(0x50) == 4);
+	CHECK(highest_bit(0x50) == 6);
+	CHECK(lowest_bit(uint64_t(1) << 63) == 63);
+	CHECK(highest_bit(~uint64_t(0)) == 63);
+	}
+
+TEST_CASE("timer wheel")
+	{
+	using zeek::detail::PQ_Element;
+	using zeek::detail::PriorityQueue;
+	using zeek::detail::TimerWheel;
+
+	// Run the same random sequence of operations against the heap and
+	// the wheel and make sure elements come out in the same order.
+	std::mt19937_64 rng(1);
+	std::vector<PQ_Element> heap_elements;
+	std::vector<PQ_Element> wheel_elements;
+	const int n = 20000;
+	heap_elements.reserve(n);
+	wheel_elements.reserve(n);
+
+	PriorityQueue pq;
+	TimerWheel wheel(0.001);
+	double now = 1e9;
+
+	for ( int i = 0; i < n; ++i )
+		{
+		// Mostly near-term times, with some far in the future, some
+		// in the past and some duplicates.
+		double t;
+		switch ( rng() % 8 )
+			{
+			case 0: t = now + double(rng() % 100000000); break;
+			case 1: t = now - 1; break;
+			case 2: t = now; break;
+			default: t = now + double(rng() % 600000) / 1000.0; break;
+			}
+
+		heap_elements.emplace_back(t);
+		wheel_elements.emplace_back(t);
+		pq.Add(&heap_elements.back());
+		wheel.Add(&wheel_elements.back());
+
+		if ( rng() % 4 == 0 )
+			{
+			size_t victim = rng() % heap_elements.size();
+			bool in_heap = pq.Remove(&heap_elements[victim]) != nullptr;
+			bool in_wheel = wheel.Remove(&wheel_elements[victim]) != nullptr;
+			REQUIRE(in_heap == in_wheel);
+			}
+
+		if ( rng() % 16 == 0 )
+			{
+			now += double(rng() % 100000) / 1000.0;
+
+			while ( pq.Top() && pq.Top()->Time() <= now )
+				{
+				REQUIRE(wheel.Top());
+				REQUIRE(pq.Remove()->Time() == wheel.Remove()->Time());
+				}
+
+			REQUIRE(wheel.Size() == pq.Size());
+			}
+		}
+
+	while ( pq.Top() )
+		{
+		REQUIRE(wheel.Top());
+		REQUIRE(pq.Remove()->Time() == wheel.Remove()->Time());
+		}
+
+	CHECK(wheel.Top() == nullptr);
+	CHECK(wheel.Size() == 0);
+	CHECK(wheel.CumulativeNum() == n);
+
+	// Removing an element that's not queued is a no-op.
+	CHECK(wheel.Remove(&wheel_elements[0]) == nullptr);
+	}
+
+namespace
+	{
+
+struct TimerTraceOp
+	{
+	enum
+		{
+		ADD,
+		CANCEL,
+		ADVANCE
+		} op;
+	double t;
+	size_t element;
+	};
+
+// Reads the timer operations from a debug.log written by "zeek -B tm".
+std::vector<TimerTraceOp> read_timer_trace(const char* path, size_t* num_elements)
+	{
+	std::vector<TimerTraceOp> ops;
+	std::unordered_map<void*, size_t> live;
+	std::ifstream in(path);
+	std::string line;
+
+	while ( std::getline(in, line) )
+		{
+		auto pos = line.find("[tm] ");
+		if ( pos == std::string::npos )
+			continue;
+
+		const char* msg = line.c_str() + pos + 5;
+		void* ptr;
+		double t;
+
+		if ( sscanf(msg, "Adding timer %*s (%p) at %lf", &ptr, &t) == 2 )
+			{
+			live[ptr] = *num_elements;
+			ops.push_back({TimerTraceOp::ADD, t, (*num_elements)++});
+			}
+
+		else if ( sscanf(msg, "Canceling timer %*s (%p)", &ptr) == 1 )
+			{
+			if ( auto it = live.find(ptr); it != live.end() )
+				ops.push_back({TimerTraceOp::CANCEL, 0.0, it->second});
+			}
+
+		else if ( sscanf(msg, "advancing timer mgr to %lf", &t) == 1 )
+			ops.push_back({TimerTraceOp::ADVANCE, t, 0});
+		}
+
+	return ops;
+	}
+
+// Makes up a trace resembling a busy worker's: connections come and go,
+// each with an inactivity timer that gets re-armed as packets arrive, and
+// TCP connection attempt timers that mostly get canceled.
+std::vector<TimerTraceOp> make_timer_trace(size_t* num_elements)
+	{
+	struct Flow
+		{
+		size_t inactivity;
+		size_t attempt;
+		bool established;
+		};
+
+	std::vector<TimerTraceOp> ops;
+	std::vector<Flow> flows;
+	std::mt19937_64 rng(42);
+	double now = 1.6e9;
+
+	auto add = [&](double t)
+	{
+		ops.push_back({TimerTraceOp::ADD, t, *num_elements});
+		return (*num_elements)++;
+	};
+
+	for ( int i = 0; i < 2000000; ++i )
+		{
+		now += double(rng() % 100) / 1e6;
+		ops.push_back({TimerTraceOp::ADVANCE, now, 0});
+
+		int r = rng() % 100;
+
+		if ( r < 5 || flows.empty() )
+			{
+			Flow f{add(now + 30.0 + double(rng() % 270)), add(now + 5.0), false};
+
+			if ( flows.size() < 200000 )
+				flows.push_back(f);
+			else
+				flows[rng() % flows.size()] = f;
+
+			continue;
+			}
+
+		Flow& f = flows[rng() % flows.size()];
+
+		if ( ! f.established )
+			{
+			ops.push_back({TimerTraceOp::CANCEL, 0.0, f.attempt});
+			f.established = true;
+			}
+
+		if ( r < 15 )
+			{
+			ops.push_back({TimerTraceOp::CANCEL, 0.0, f.inactivity});
+			f.inactivity = add(now + 30.0 + double(rng() % 270));
+			}
+		}
+
+	return ops;
+	}
+
+template <typename Queue>
+uint64_t replay_timer_trace(Queue& q, const std::vector<TimerTraceOp>& ops,
+                            std::vector<zeek::detail::PQ_Element>& elements)
+	{
+	uint64_t dispatched = 0;
+
+	for ( const auto& op : ops )
+		{
+		switch ( op.op )
+			{
+			case TimerTraceOp::ADD: q.Add(&elements[op.element]); break;
+			case TimerTraceOp::CANCEL: q.Remove(&elements[op.element]); break;
+			case TimerTraceOp::ADVANCE:
+				while ( q.Top() && q.Top()->Time() <= op.t )
+					{
+					q.Remove();
+					++dispatched;
+					}
+				break;
+			}
+		}
+
+	// The queues delete what's left in them.
+	while ( q.Remove() )
+		;
+
+	return dispatched;
+	}
+
+	}
+
+TEST_CASE("timer wheel benchmark" * doctest::skip())
+	{
+	// Run with: zeek --test --no-skip -tc="timer wheel benchmark"
+	//
+	// To replay timers from real traffic, record them with
+	// "zeek -B tm -r trace.pcap" and set ZEEK_TIMER_TRACE to the
+	// resulting debug.log.
+	using zeek::detail::PQ_Element;
+	using clock = std::chrono::steady_clock;
+
+	size_t num_elements = 0;
+	std::vector<TimerTraceOp> ops;
+
+	if ( const char* path = getenv("ZEEK_TIMER_TRACE") )
+		ops = read_timer_trace(path, &num_elements);
+	else
+		ops = make_timer_trace(&num_elements);
+
+	REQUIRE(! ops.empty());
+
+	// Returns nanoseconds per operation and the number of dispatched
+	// elements.
+	auto run = [&](auto& q)
+	{
+		std::vector<PQ_Element> elements;
+		elements.reserve(num_elements);
+
+		for ( const auto& op : ops )
+			if ( op.op == TimerTraceOp::ADD )
+				elements.emplace_back(op.t);
+
+		auto start = clock::now();
+		uint64_t dispatched = replay_timer_trace(q, ops, elements);
+		auto elapsed = clock::now() - start;
+
+		return std::make_pair(std::chrono::duration<double, std::nano>(elapsed).count() /
+		                          ops.size(),
+		                      dispatched);
+	};
+
+	zeek::detail::PriorityQueue pq;
+	auto [pq_ns, pq_dispatched] = run(pq);
+
+	zeek::detail::TimerWheel wheel;
+	auto [wheel_ns, wheel_dispatched] = run(wheel);
+
+	MESSAGE(ops.size() << " operations, peak of " << pq.PeakSize() << " pending timers");
+	MESSAGE("priority queue: " << pq_ns << " ns/op");
+	MESSAGE("timer wheel:    " << wheel_ns << " ns/op");
+	CHECK(pq_dispatched == wheel_dispatched);
+	}
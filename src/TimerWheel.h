@@ -0,0 +1,162 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "zeek/PriorityQueue.h"
+
+namespace zeek::detail
+	{
+
+/**
+ * A hierarchical timing wheel, usable in place of a PriorityQueue for
+ * elements that are mostly added with times in the near future and removed
+ * in time order, as timers are. Adding and removing arbitrary elements take
+ * constant time, compared to logarithmic time for the heap.
+ *
+ * Element times are quantized into ticks of a given resolution. The wheel
+ * has four levels of 256 buckets each: level 0 holds elements due within
+ * the next 256 ticks, one tick per bucket, and each further level covers
+ * 256 times the range of the previous one. Elements even further out are
+ * kept in an overflow list. As the wheel turns, the buckets of higher
+ * levels get redistributed into lower levels, and finally the elements of
+ * the next non-empty level 0 bucket move into a small heap, along with any
+ * elements added for times at or before the current tick. Top() and
+ * Remove() therefore return elements in exactly the same order as a plain
+ * PriorityQueue does; the resolution only determines how many elements
+ * are in the small heap at a time.
+ *
+ * Looking for the earliest element turns the wheel up to it, which may be
+ * well ahead of the time new elements get added for, for example when the
+ * wheel was empty before. If too many elements end up in the small heap
+ * that way, the wheel gets rebuilt starting from the earliest one.
+ */
+class TimerWheel
+	{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param resolution The duration of one tick, in seconds.
+	 */
+	explicit TimerWheel(double resolution = 0.001);
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	// Returns the element with the earliest time, or nil if the wheel
+	// is empty. This may need to turn the wheel, hence isn't const.
+	PQ_Element* Top()
+		{
+		if ( current.Size() == 0 && ! LoadNext() )
+			return nullptr;
+
+		return current.Top();
+		}
+
+	// Removes (and returns) the element with the earliest time. Returns
+	// nil if the wheel is empty.
+	PQ_Element* Remove();
+
+	// Removes element e. Returns e, or nullptr if e wasn't in the wheel.
+	PQ_Element* Remove(PQ_Element* e);
+
+	// Adds a new element. Always succeeds; the return value mirrors
+	// PriorityQueue::Add().
+	bool Add(PQ_Element* e);
+
+	// Removes and deletes all elements for which pred returns true.
+	// Returns the number of elements deleted.
+	template <typename Pred> int RemoveIf(Pred pred)
+		{
+		int removed = current.RemoveIf(pred);
+
+		for ( int b = 0; b <= OVERFLOW_BUCKET; ++b )
+			{
+			auto& bucket = buckets[b];
+			size_t n = 0;
+
+			for ( auto* e : bucket )
+				{
+				if ( pred(e) )
+					{
+					delete e;
+					++removed;
+					}
+				else
+					{
+					e->SetOffset(n);
+					bucket[n++] = e;
+					}
+				}
+
+			bucket.resize(n);
+
+			if ( n == 0 && b < OVERFLOW_BUCKET )
+				occupied[b / SLOTS][(b % SLOTS) / 64] &= ~(uint64_t(1) << (b % 64));
+			}
+
+		size -= removed;
+		return removed;
+		}
+
+	int Size() const { return size; }
+	int PeakSize() const { return peak_size; }
+	uint64_t CumulativeNum() const { return cumulative_num; }
+
+	double Resolution() const { return resolution; }
+
+private:
+	static constexpr int LEVEL_BITS = 8;
+	static constexpr int SLOTS = 1 << LEVEL_BITS;
+	static constexpr int LEVELS = 4;
+
+	// Bucket numbers beyond the wheel's slots.
+	static constexpr int OVERFLOW_BUCKET = LEVELS * SLOTS;
+	static constexpr int CURRENT_BUCKET = OVERFLOW_BUCKET + 1;
+
+	uint64_t Tick(double t) const;
+
+	// Puts an element into the bucket matching its time, relative to
+	// the current tick.
+	void Place(PQ_Element* e);
+
+	void AddToBucket(int b, PQ_Element* e);
+	void AddToCurrent(PQ_Element* e);
+
+	// Returns the first occupied slot of a level at or after the given
+	// one, or -1 if there's none.
+	int NextOccupied(int level, int slot) const;
+
+	// Turns the wheel to the next non-empty bucket and moves its
+	// elements into the current heap. Returns false if the wheel is
+	// empty.
+	bool LoadNext();
+
+	// Places all elements anew, with the wheel turned back to the
+	// earliest one.
+	void Rewind();
+
+	double resolution;
+	uint64_t cursor = 0; // the current tick
+
+	// The wheel's slots, level by level, followed by the overflow list.
+	std::vector<PQ_Element*> buckets[OVERFLOW_BUCKET + 1];
+	uint64_t occupied[LEVELS][SLOTS / 64] = {};
+
+	// The elements due at or before the current tick.
+	PriorityQueue current;
+
+	// The number of elements added for times before the current tick
+	// since the wheel last turned.
+	int num_early = 0;
+
+	int size = 0;
+	int peak_size = 0;
+	uint64_t cumulative_num = 0;
+	};
+
+	} // namespace zeek::detail
@@ -189,6 +189,16 @@ public:
 		conns->push_back(c);
 		}
 
+	/**
+	 * Removes all encapsulations from the stack, keeping the memory
+	 * allocated for them around for reuse.
+	 */
+	void Clear()
+		{
+		if ( conns )
+			conns->clear();
+		}
+
 	/**
 	 * Return how many nested tunnels are involved in a encapsulation, zero
 	 * meaning no tunnels are present.
@@ -12,9 +12,11 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
 #include <set>
 
 #include "zeek/Attr.h"
@@ -1673,6 +1675,101 @@ TableEntryVal* TableEntryVal::Clone(Val::CloneState* state)
 	return rval;
 	}
 
+namespace detail
+	{
+
+/**
+ * An index of a table's entries by the time of their last expiration-relevant
+ * access, so that expiring entries only needs to look at the ones that are
+ * due instead of the whole table. Entries are filed under copies of their
+ * keys in buckets of one second, the resolution of TableEntryVal's access
+ * times.
+ *
+ * The index doesn't change as entries get accessed or removed. Instead, when
+ * an entry's bucket comes up, TableVal::DoExpire() checks whether the entry
+ * still exists and whether it has been accessed since, in which case it gets
+ * filed again under its new access time.
+ */
+class TableExpireIndex
+	{
+public:
+	// Files the entry with the given key under the given time.
+	void Add(const HashKey& k, TableEntryVal* v, int time)
+		{
+		auto& keys = buckets[time].keys;
+		hash_t hash = k.Hash();
+		uint32_t size = k.Size();
+
+		size_t offset = keys.size();
+		keys.resize(offset + sizeof(hash) + sizeof(size) + size);
+		memcpy(&keys[offset], &hash, sizeof(hash));
+		memcpy(&keys[offset + sizeof(hash)], &size, sizeof(size));
+		memcpy(&keys[offset + sizeof(hash) + sizeof(size)], k.Key(), size);
+
+		v->expire_index_time = time;
+		++num_keys;
+		}
+
+	// Returns true and sets time to the earliest bucket's time if the
+	// index isn't empty.
+	bool Earliest(int* time) const
+		{
+		if ( buckets.empty() )
+			return false;
+
+		*time = buckets.begin()->first;
+		return true;
+		}
+
+	// Takes the next key out of the earliest bucket. Must not be called
+	// if the index is empty.
+	HashKey Take()
+		{
+		auto it = buckets.begin();
+		auto& b = it->second;
+
+		hash_t hash;
+		uint32_t size;
+		memcpy(&hash, &b.keys[b.pos], sizeof(hash));
+		memcpy(&size, &b.keys[b.pos + sizeof(hash)], sizeof(size));
+
+		HashKey k(&b.keys[b.pos + sizeof(hash) + sizeof(size)], size, hash);
+		b.pos += sizeof(hash) + sizeof(size) + size;
+		--num_keys;
+
+		if ( b.pos == b.keys.size() )
+			buckets.erase(it);
+
+		return k;
+		}
+
+	// Returns the number of keys filed, including ones of entries that
+	// have since been removed or filed again.
+	size_t Size() const { return num_keys; }
+
+	void Clear()
+		{
+		buckets.clear();
+		num_keys = 0;
+		}
+
+private:
+	struct Bucket
+		{
+		// The bucket's keys, each stored as its hash, its size, and its
+		// bytes, in the order they got added.
+		std::vector<char> keys;
+
+		// The offset of the next key to take.
+		size_t pos = 0;
+		};
+
+	std::map<int, Bucket> buckets;
+	size_t num_keys = 0;
+	};
+
+	} // namespace detail
+
 TableValTimer::TableValTimer(TableVal* val, double t) : detail::Timer(t, detail::TIMER_TABLE_VAL)
 	{
 	table = val;
@@ -1788,7 +1885,6 @@ void TableVal::Init(TableTypePtr t, bool ordered)
 	table_type = std::move(t);
 	expire_func = nullptr;
 	expire_time = nullptr;
-	expire_iterator = nullptr;
 	timer = nullptr;
 	def_val = nullptr;
 
@@ -1814,13 +1910,13 @@ TableVal::~TableVal()
 	delete table_hash;
 	delete table_val;
 	delete subnets;
-	delete expire_iterator;
 	}
 
 void TableVal::RemoveAll()
 	{
-	delete expire_iterator;
-	expire_iterator = nullptr;
+	if ( expire_index )
+		expire_index->Clear();
+
 	// Here we take the brute force approach.
 	delete table_val;
 	table_val = new PDict<TableEntryVal>;
@@ -1957,7 +2053,19 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k, ValPtr n
 
 	// Keep old expiration time if necessary.
 	if ( old_entry_val && attrs && attrs->Find(detail::ATTR_EXPIRE_CREATE) )
-		new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
+		new_entry_val->expire_access_time = old_entry_val->expire_access_time;
+
+	if ( expire_index )
+		{
+		// A replacement takes over the old entry's place in the index,
+		// unless it's due earlier.
+		if ( old_entry_val &&
+		     old_entry_val->expire_index_time != TableEntryVal::NOT_EXPIRE_INDEXED &&
+		     old_entry_val->expire_index_time <= new_entry_val->expire_access_time )
+			new_entry_val->expire_index_time = old_entry_val->expire_index_time;
+		else
+			expire_index->Add(k_copy, new_entry_val, new_entry_val->expire_access_time);
+		}
 
 	Modified();
 
@@ -2816,6 +2924,17 @@ void TableVal::InitTimer(double delay)
 	detail::timer_mgr->Add(timer);
 	}
 
+void TableVal::BuildExpireIndex()
+	{
+	expire_index = std::make_unique<detail::TableExpireIndex>();
+
+	for ( const auto& tble : *table_val )
+		{
+		auto k = tble.GetHashKey();
+		expire_index->Add(*k, tble.value, tble.value->expire_access_time);
+		}
+	}
+
 void TableVal::DoExpire(double t)
 	{
 	if ( ! type )
@@ -2828,95 +2947,143 @@ void TableVal::DoExpire(double t)
 		// error, it has been reported already.
 		return;
 
-	if ( ! expire_iterator )
-		{
-		auto it = table_val->begin_robust();
-		expire_iterator = new RobustDictIterator(std::move(it));
+	// The index gets built on first use, so that it also covers entries
+	// added without going through Assign(), as when cloning.
+	if ( ! expire_index )
+		BuildExpireIndex();
+
+	// Returns true if the entries filed under the given time are due.
+	auto due = [&](int time)
+	{
+		double access_time = run_state::zeek_start_network_time + time;
+
+		// An access time of 0 happens when we insert val while
+		// network_time hasn't been initialized yet (e.g. in zeek_init()),
+		// and also when zeek_start_network_time hasn't been initialized
+		// (e.g. before first packet).  The expire_access_time is correct,
+		// so we just need to wait.
+		return access_time != 0 && access_time + timeout < t;
+	};
+
+	// Take the keys of the entries that are due off the index first, so
+	// that the entries expire in the order in which iterating over the
+	// table visits them, as when expiration walked the whole table.
+	std::vector<std::pair<detail::HashKey, int>> due_keys;
+	std::vector<std::pair<int, size_t>> positions;
+	int time;
+
+	for ( int i = 0; i < zeek::detail::table_incremental_step && expire_index->Earliest(&time) &&
+	                 due(time);
+	      ++i )
+		{
+		auto k = expire_index->Take();
+		// Iterating over ordered tables visits the entries in the order
+		// in which they were added, which we don't keep track of, so
+		// those expire in the order of the index.
+		int position = static_cast<int>(positions.size());
+		auto v = table_val->IsOrdered() ? table_val->Lookup(&k) : table_val->Lookup(&k, &position);
+
+		if ( ! v || v->expire_index_time != time )
+			// Removed since, or filed elsewhere.
+			continue;
+
+		if ( v->expire_access_time > time )
+			{
+			// Accessed since.
+			expire_index->Add(k, v, v->expire_access_time);
+			continue;
+			}
+
+		positions.emplace_back(position, due_keys.size());
+		due_keys.emplace_back(std::move(k), time);
 		}
 
+	std::sort(positions.begin(), positions.end());
+
+	// Entries that &expire_func wants to keep around get filed again only
+	// once we're done, so that we don't ask about them twice in one go.
+	std::vector<std::pair<detail::HashKey, int>> kept;
 	bool modified = false;
 
-	for ( int i = 0;
-	      i < zeek::detail::table_incremental_step && *expire_iterator != table_val->end_robust();
-	      ++i, ++(*expire_iterator) )
+	for ( const auto& [position, i] : positions )
 		{
-		auto v = (*expire_iterator)->value;
+		auto& k = due_keys[i].first;
+		time = due_keys[i].second;
 
-		if ( v->ExpireAccessTime() == 0 )
+		// Look the entry up again, as the &expire_func calls for the ones
+		// before may have changed it.
+		auto v = table_val->Lookup(&k);
+
+		if ( ! v || v->expire_index_time != time )
+			continue;
+
+		if ( v->expire_access_time > time )
 			{
-			// This happens when we insert val while network_time
-			// hasn't been initialized yet (e.g. in zeek_init()), and
-			// also when zeek_start_network_time hasn't been initialized
-			// (e.g. before first packet).  The expire_access_time is
-			// correct, so we just need to wait.
+			expire_index->Add(k, v, v->expire_access_time);
+			continue;
 			}
 
-		else if ( v->ExpireAccessTime() + timeout < t )
+		ListValPtr idx = nullptr;
+
+		if ( expire_func )
 			{
-			auto k = (*expire_iterator)->GetHashKey();
-			ListValPtr idx = nullptr;
+			idx = RecreateIndex(k);
+			double secs = CallExpireFunc(idx);
 
-			if ( expire_func )
-				{
-				idx = RecreateIndex(*k);
-				double secs = CallExpireFunc(idx);
+			// It's possible that the user-provided
+			// function modified or deleted the table
+			// value, so look it up again.
+			v = table_val->Lookup(&k);
 
-				// It's possible that the user-provided
-				// function modified or deleted the table
-				// value, so look it up again.
-				v = table_val->Lookup(k.get());
+			if ( ! v )
+				// user-provided function deleted it
+				continue;
 
-				if ( ! v )
-					{ // user-provided function deleted it
-					if ( ! expire_iterator )
-						// Entire table got dropped (e.g. clear_table() / RemoveAll())
-						break;
+			if ( secs > 0 )
+				{
+				// User doesn't want us to expire
+				// this now.
+				v->SetExpireAccess(run_state::network_time - timeout + secs);
 
-					continue;
-					}
+				if ( v->expire_index_time == time )
+					kept.emplace_back(std::move(k), time);
 
-				if ( secs > 0 )
-					{
-					// User doesn't want us to expire
-					// this now.
-					v->SetExpireAccess(run_state::network_time - timeout + secs);
-					continue;
-					}
-				}
-
-			if ( subnets )
-				{
-				if ( ! idx )
-					idx = RecreateIndex(*k);
-				if ( ! subnets->Remove(idx.get()) )
-					reporter->InternalWarning("index not in prefix table");
+				continue;
 				}
+			}
 
-			table_val->RemoveEntry(k.get());
-			if ( change_func )
-				{
-				if ( ! idx )
-					idx = RecreateIndex(*k);
+		if ( subnets )
+			{
+			if ( ! idx )
+				idx = RecreateIndex(k);
+			if ( ! subnets->Remove(idx.get()) )
+				reporter->InternalWarning("index not in prefix table");
+			}
 
-				CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
-				}
+		table_val->RemoveEntry(&k);
+		if ( change_func )
+			{
+			if ( ! idx )
+				idx = RecreateIndex(k);
 
-			delete v;
-			modified = true;
+			CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
 			}
+
+		delete v;
+		modified = true;
 		}
 
+	for ( auto& [k, kept_time] : kept )
+		if ( auto v = table_val->Lookup(&k); v && v->expire_index_time == kept_time )
+			expire_index->Add(k, v, v->expire_access_time);
+
 	if ( modified )
 		Modified();
 
-	if ( ! expire_iterator || (*expire_iterator) == table_val->end_robust() )
-		{
-		delete expire_iterator;
-		expire_iterator = nullptr;
-		InitTimer(zeek::detail::table_expire_interval);
-		}
-	else
+	if ( expire_index->Earliest(&time) && due(time) )
 		InitTimer(zeek::detail::table_expire_delay);
+	else
+		InitTimer(zeek::detail::table_expire_interval);
 	}
 
 double TableVal::GetExpireTime()
@@ -4,6 +4,7 @@
 
 #include <sys/types.h> // for u_char
 #include <array>
+#include <climits>
 #include <list>
 #include <unordered_map>
 #include <variant>
@@ -50,6 +51,7 @@ class Frame;
 class PrefixTable;
 class CompositeHash;
 class HashKey;
+class TableExpireIndex;
 
 class ValTrace;
 class ZBody;
@@ -736,6 +738,7 @@ public:
 
 protected:
 	friend class TableVal;
+	friend class detail::TableExpireIndex;
 
 	ValPtr val;
 
@@ -743,6 +746,12 @@ protected:
 	// to save a few bytes, as we do not need a high resolution for these
 	// anyway.
 	int expire_access_time;
+
+	// The access time under which the table's expiration index has filed
+	// this entry, or NOT_EXPIRE_INDEXED. The index doesn't get updated as
+	// the entry is accessed, so this may lag behind expire_access_time.
+	static constexpr int NOT_EXPIRE_INDEXED = INT_MIN;
+	int expire_index_time = NOT_EXPIRE_INDEXED;
 	};
 
 class TableValTimer final : public detail::Timer
@@ -1041,6 +1050,9 @@ protected:
 
 	void CheckExpireAttr(detail::AttrTag at);
 
+	// Files all of the table's entries in a new expiration index.
+	void BuildExpireIndex();
+
 	// Calculates default value for index.  Returns nullptr if none.
 	ValPtr Default(const ValPtr& index);
 
@@ -1083,7 +1095,7 @@ protected:
 	detail::ExprPtr expire_time;
 	detail::ExprPtr expire_func;
 	TableValTimer* timer;
-	RobustDictIterator<TableEntryVal>* expire_iterator;
+	std::unique_ptr<detail::TableExpireIndex> expire_index;
 	detail::PrefixTable* subnets;
 	ValPtr def_val;
 	detail::ExprPtr change_func;
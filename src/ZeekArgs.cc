@@ -1,5 +1,8 @@
 #include "zeek/ZeekArgs.h"
 
+#include <algorithm>
+
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/Desc.h"
 #include "zeek/ID.h"
 #include "zeek/Type.h"
@@ -19,6 +22,56 @@ Args val_list_to_args(const ValPList& vl)
 	return rval;
 	}
 
+namespace detail
+	{
+
+// Lists with more capacity than this don't get recycled.
+static constexpr size_t MAX_RECYCLED_ARGS = 16;
+
+// The number of spare lists kept at most.
+static constexpr size_t MAX_SPARE_ARGS = 4096;
+
+static std::vector<Args>& spare_args()
+	{
+	// Never destroyed, as events may still get released during static
+	// destruction.
+	static auto* spares = new std::vector<Args>();
+	return *spares;
+	}
+
+Args AcquireArgs(size_t n)
+	{
+	auto& spares = spare_args();
+	Args rval;
+
+	if ( ! spares.empty() )
+		{
+		rval = std::move(spares.back());
+		spares.pop_back();
+		}
+
+	// Most events have just a few arguments; size new lists so that
+	// they fit the typical one once recycled.
+	rval.reserve(std::max(n, size_t(4)));
+	return rval;
+	}
+
+void RecycleArgs(Args&& args)
+	{
+	if ( args.capacity() == 0 || args.capacity() > MAX_RECYCLED_ARGS )
+		return;
+
+	auto& spares = spare_args();
+
+	if ( spares.size() >= MAX_SPARE_ARGS )
+		return;
+
+	args.clear();
+	spares.push_back(std::move(args));
+	}
+
+	} // namespace detail
+
 VectorValPtr MakeCallArgumentVector(const Args& vals, const RecordTypePtr& types)
 	{
 	static auto call_argument_vector = id::find_type<VectorType>("call_argument_vector");
@@ -59,3 +112,26 @@ VectorValPtr MakeEmptyCallArgumentVector()
 	}
 
 	} // namespace zeek
+
+TEST_CASE("recycled args")
+	{
+	using namespace zeek::detail;
+
+	auto args = AcquireArgs(2);
+	CHECK(args.empty());
+	CHECK(args.capacity() >= 2);
+
+	const auto* storage = args.data();
+	RecycleArgs(std::move(args));
+
+	// The most recently recycled list comes back first.
+	auto again = AcquireArgs(1);
+	CHECK(again.data() == storage);
+
+	// Oversized lists get dropped.
+	auto big = AcquireArgs(100);
+	RecycleArgs(std::move(big));
+	CHECK(AcquireArgs(1).capacity() < 100);
+
+	RecycleArgs(std::move(again));
+	}
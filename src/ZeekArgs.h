@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include "zeek/ZeekList.h"
@@ -29,6 +30,36 @@ using Args = std::vector<ValPtr>;
  */
 Args val_list_to_args(const ValPList& vl);
 
+namespace detail
+	{
+
+/**
+ * Returns an empty argument list with room for at least \a n elements. The
+ * list reuses the storage of a list previously passed to RecycleArgs() if
+ * there's one, so that building event arguments doesn't normally allocate.
+ * Like the event queue, the recycling is meant for the main thread only.
+ */
+Args AcquireArgs(size_t n);
+
+/**
+ * Releases an argument list's elements and keeps its storage around for
+ * AcquireArgs(). Lists that are very large aren't kept.
+ */
+void RecycleArgs(Args&& args);
+
+	} // namespace detail
+
+/**
+ * Builds an argument list from the given values, using recycled storage
+ * from detail::AcquireArgs().
+ */
+template <class... Ts> Args MakeArgs(Ts&&... vals)
+	{
+	Args args = detail::AcquireArgs(sizeof...(Ts));
+	(args.push_back(std::forward<Ts>(vals)), ...);
+	return args;
+	}
+
 /**
  * Creates a vector of "call_argument" meta data describing the arguments to
  * function/event invocation.
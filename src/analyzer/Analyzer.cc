@@ -7,6 +7,7 @@
 
 #include "zeek/3rdparty/doctest.h"
 #include "zeek/Event.h"
+#include "zeek/ObjectPool.h"
 #include "zeek/ZeekString.h"
 #include "zeek/analyzer/Manager.h"
 #include "zeek/analyzer/protocol/pia/PIA.h"
@@ -39,22 +40,19 @@ AnalyzerTimer::AnalyzerTimer(Analyzer* arg_analyzer, analyzer_timer_func arg_tim
 	Init(arg_analyzer, arg_timer, arg_do_expire);
 	}
 
-AnalyzerTimer::~AnalyzerTimer()
-	{
-	analyzer->RemoveTimer(this);
-	Unref(analyzer->Conn());
-	}
+AnalyzerTimer::~AnalyzerTimer() { }
 
 void AnalyzerTimer::Dispatch(double t, bool is_expire)
 	{
 	if ( is_expire && ! do_expire )
 		return;
 
-	// Remove ourselves from the connection's set of timers so
-	// it doesn't try to cancel us.
-	analyzer->RemoveTimer(this);
-
+	// The handler may cancel the analyzer's timers, which drops the
+	// group's reference to the connection.
+	Connection* conn = analyzer->Conn();
+	Ref(conn);
 	(analyzer->*timer)(t);
+	Unref(conn);
 	}
 
 void AnalyzerTimer::Init(Analyzer* arg_analyzer, analyzer_timer_func arg_timer, int arg_do_expire)
@@ -63,9 +61,12 @@ void AnalyzerTimer::Init(Analyzer* arg_analyzer, analyzer_timer_func arg_timer,
 	timer = arg_timer;
 	do_expire = arg_do_expire;
 
-	// We need to Ref the connection as the analyzer doesn't do it and
-	// we need to have it around until we expire.
-	Ref(analyzer->Conn());
+	// The analyzer doesn't hold a reference to the connection, so the
+	// timer group does, keeping it around until we expire.
+	if ( ! analyzer->timer_group )
+		analyzer->timer_group = new zeek::detail::TimerGroup(analyzer->Conn());
+
+	SetGroup(analyzer->timer_group);
 	}
 
 analyzer::ID Analyzer::id_counter = 0;
@@ -165,6 +166,25 @@ Analyzer::~Analyzer()
 		}
 
 	delete output_handler;
+	Unref(timer_group);
+	}
+
+static zeek::detail::SizeClassPool& analyzer_pool()
+	{
+	// Never destroyed, as analyzers may still get released during
+	// static destruction.
+	static auto* pool = new zeek::detail::SizeClassPool("analyzer", 2048);
+	return *pool;
+	}
+
+void* Analyzer::operator new(size_t size)
+	{
+	return analyzer_pool().Allocate(size);
+	}
+
+void Analyzer::operator delete(void* ptr, size_t size)
+	{
+	analyzer_pool().Free(ptr, size);
 	}
 
 void Analyzer::Init() { }
@@ -752,29 +772,21 @@ void Analyzer::AddTimer(analyzer_timer_func timer, double t, bool do_expire,
 	zeek::detail::Timer* analyzer_timer = new AnalyzerTimer(this, timer, t, do_expire, type);
 
 	zeek::detail::timer_mgr->Add(analyzer_timer);
-	timers.push_back(analyzer_timer);
-	}
-
-void Analyzer::RemoveTimer(zeek::detail::Timer* t)
-	{
-	timers.remove(t);
 	}
 
 void Analyzer::CancelTimers()
 	{
-	// We are going to cancel our timers which, in turn, may cause them to
-	// call RemoveTimer(), which would then modify the list we're just
-	// traversing.  Thus, we first make a copy of the list which we then
-	// iterate through.
-	TimerPList tmp(timers.length());
-	std::copy(timers.begin(), timers.end(), back_inserter(tmp));
+	timers_canceled = true;
 
-	// TODO: could be a for_each
-	for ( auto timer : tmp )
-		zeek::detail::timer_mgr->Cancel(timer);
+	if ( ! timer_group )
+		return;
 
-	timers_canceled = true;
-	timers.clear();
+	// Timers added later go into a new group.
+	auto* group = timer_group;
+	timer_group = nullptr;
+
+	zeek::detail::timer_mgr->Cancel(group);
+	Unref(group);
 	}
 
 void Analyzer::AppendNewChildren()
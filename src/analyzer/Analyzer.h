@@ -141,6 +141,14 @@ public:
 	 */
 	virtual ~Analyzer();
 
+	/**
+	 * Analyzers are allocated from a set of ObjectPools, one for each
+	 * size class of the derived analyzer classes. Analyzers larger than
+	 * the largest size class use the regular allocator.
+	 */
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	/**
 	 * Initializes the analyzer before input processing starts.
 	 */
@@ -622,7 +630,7 @@ public:
 	std::enable_if_t<std::is_convertible_v<std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	EnqueueConnEvent(EventHandlerPtr h, Args&&... args)
 		{
-		return EnqueueConnEvent(h, zeek::Args{std::forward<Args>(args)...});
+		return EnqueueConnEvent(h, zeek::MakeArgs(std::forward<Args>(args)...));
 		}
 
 	/**
@@ -671,15 +679,16 @@ protected:
 	void AddTimer(analyzer_timer_func timer, double t, bool do_expire, detail::TimerType type);
 
 	/**
-	 * Cancels all timers added previously via AddTimer().
+	 * Cancels all timers added previously via AddTimer(). This is a single
+	 * operation on the analyzer's TimerGroup, regardless of the number of
+	 * timers.
 	 */
 	void CancelTimers();
 
-	/**
-	 * Removes a given timer. This is an internal method and shouldn't be
-	 * used by derived class. It does not cancel the timer.
-	 */
-	void RemoveTimer(detail::Timer* t);
+	[[deprecated("Remove in v7.1 - Analyzer timers are canceled as a group.")]] void
+	RemoveTimer(detail::Timer* t)
+		{
+		}
 
 	/**
 	 * Returns true if the analyzer has associated an SupportAnalyzer of a given type.
@@ -759,7 +768,7 @@ private:
 	bool protocol_confirmed;
 	bool analyzer_confirmed;
 
-	TimerPList timers;
+	detail::TimerGroup* timer_group = nullptr; // created with the first timer
 	bool timers_canceled;
 	bool skip;
 	bool finished;
@@ -7,6 +7,7 @@
 #include "zeek/Event.h"
 #include "zeek/File.h"
 #include "zeek/NetVar.h"
+#include "zeek/ObjectPool.h"
 #include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/Val.h"
@@ -52,6 +53,22 @@ TCP_Endpoint::~TCP_Endpoint()
 	delete contents_processor;
 	}
 
+static zeek::detail::ObjectPool& endpoint_pool()
+	{
+	static auto* pool = new zeek::detail::ObjectPool("tcp-endpoint", sizeof(TCP_Endpoint));
+	return *pool;
+	}
+
+void* TCP_Endpoint::operator new(size_t size)
+	{
+	return endpoint_pool().Allocate(size);
+	}
+
+void TCP_Endpoint::operator delete(void* ptr, size_t size)
+	{
+	endpoint_pool().Free(ptr, size);
+	}
+
 Connection* TCP_Endpoint::Conn() const
 	{
 	return tcp_analyzer->Conn();
@@ -40,6 +40,10 @@ public:
 	TCP_Endpoint(packet_analysis::TCP::TCPSessionAdapter* analyzer, bool is_orig);
 	~TCP_Endpoint();
 
+	// Endpoints are allocated from a dedicated ObjectPool.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	void Done();
 
 	packet_analysis::TCP::TCPSessionAdapter* TCP() { return tcp_analyzer; }
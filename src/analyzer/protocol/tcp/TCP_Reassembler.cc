@@ -3,6 +3,7 @@
 #include <algorithm>
 
 #include "zeek/File.h"
+#include "zeek/ObjectPool.h"
 #include "zeek/Reporter.h"
 #include "zeek/RuleMatcher.h"
 #include "zeek/ZeekString.h"
@@ -59,6 +60,22 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 		}
 	}
 
+static zeek::detail::ObjectPool& reassembler_pool()
+	{
+	static auto* pool = new zeek::detail::ObjectPool("tcp-reassembler", sizeof(TCP_Reassembler));
+	return *pool;
+	}
+
+void* TCP_Reassembler::operator new(size_t size)
+	{
+	return reassembler_pool().Allocate(size);
+	}
+
+void TCP_Reassembler::operator delete(void* ptr, size_t size)
+	{
+	reassembler_pool().Free(ptr, size);
+	}
+
 void TCP_Reassembler::Done()
 	{
 	MatchUndelivered(-1, true);
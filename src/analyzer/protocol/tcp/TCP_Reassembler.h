@@ -35,6 +35,10 @@ public:
 	                packet_analysis::TCP::TCPSessionAdapter* arg_tcp_analyzer, Type arg_type,
 	                TCP_Endpoint* arg_endp);
 
+	// Reassemblers are allocated from a dedicated ObjectPool.
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
 	void Done();
 
 	void SetDstAnalyzer(analyzer::Analyzer* analyzer) { dst_analyzer = analyzer; }
@@ -0,0 +1,131 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/iosource/PacketRing.h"
+
+#include <cassert>
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::iosource::detail
+	{
+
+PacketRing::PacketRing(size_t capacity) : slots(capacity > 0 ? capacity : 1) { }
+
+PacketRing::Slot* PacketRing::BeginWrite(bool block)
+	{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	if ( block )
+		can_write.wait(lock, [this] { return shut_down || written - released < slots.size(); });
+
+	if ( shut_down || written - released >= slots.size() )
+		return nullptr;
+
+	return &slots[written % slots.size()];
+	}
+
+void PacketRing::CommitWrite()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		++written;
+		}
+
+	can_read.notify_one();
+	}
+
+void PacketRing::Finish()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		finished = true;
+		}
+
+	can_read.notify_one();
+	}
+
+PacketRing::Slot* PacketRing::BeginRead(bool block)
+	{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	if ( block )
+		can_read.wait(lock, [this] { return finished || read < written; });
+
+	if ( read >= written )
+		return nullptr;
+
+	return &slots[read++ % slots.size()];
+	}
+
+void PacketRing::EndRead(size_t n)
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		assert(released + n <= read);
+		released += n;
+		}
+
+	can_write.notify_one();
+	}
+
+void PacketRing::Shutdown()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mtx);
+		shut_down = true;
+		}
+
+	can_write.notify_one();
+	}
+
+bool PacketRing::Drained() const
+	{
+	std::lock_guard<std::mutex> lock(mtx);
+	return finished && read >= written;
+	}
+
+TEST_CASE("packet ring")
+	{
+	PacketRing ring(2);
+	pkt_timeval ts = {1, 2};
+	const u_char data[] = {1, 2, 3};
+
+	CHECK(ring.BeginRead(false) == nullptr);
+
+	auto* s = ring.BeginWrite(false);
+	REQUIRE(s);
+	s->Assign(ts, sizeof(data), 60, 1, data);
+	ring.CommitWrite();
+
+	s = ring.BeginWrite(false);
+	REQUIRE(s);
+	s->Assign(ts, 1, 1, 1, data);
+	ring.CommitWrite();
+
+	// Full now.
+	CHECK(ring.BeginWrite(false) == nullptr);
+
+	auto* r1 = ring.BeginRead(false);
+	auto* r2 = ring.BeginRead(false);
+	REQUIRE(r1);
+	REQUIRE(r2);
+	CHECK(r1->caplen == 3);
+	CHECK(r1->len == 60);
+	CHECK(r1->data.size() == 3);
+	CHECK(r2->caplen == 1);
+	CHECK(ring.BeginRead(false) == nullptr);
+
+	// Still full until released.
+	CHECK(ring.BeginWrite(false) == nullptr);
+	ring.EndRead(2);
+	CHECK(ring.BeginWrite(false) != nullptr);
+
+	ring.Finish();
+	CHECK(ring.BeginRead(true) == nullptr);
+	CHECK(ring.Drained());
+
+	ring.Shutdown();
+	CHECK(ring.BeginWrite(true) == nullptr);
+	}
+
+	} // namespace zeek::iosource::detail
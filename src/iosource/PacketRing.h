@@ -0,0 +1,135 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "zeek/iosource/Packet.h"
+
+namespace zeek::iosource::detail
+	{
+
+/**
+ * A bounded single-producer/single-consumer ring of packet buffers for
+ * handing packets between a thread doing I/O and the main thread. Slots
+ * keep their data buffers across uses, so once the ring has warmed up
+ * moving packets through it doesn't allocate.
+ *
+ * The consumer may hold on to several slots at once (for batched
+ * processing); they are released in the order they were read.
+ */
+class PacketRing
+	{
+public:
+	/**
+	 * A single packet in the ring.
+	 */
+	struct Slot
+		{
+		pkt_timeval ts = {0, 0};
+		uint32_t caplen = 0;
+		uint32_t len = 0;
+		int link_type = -1;
+		std::vector<u_char> data;
+
+		/**
+		 * Copies packet data into the slot.
+		 */
+		void Assign(const pkt_timeval& arg_ts, uint32_t arg_caplen, uint32_t arg_len,
+		            int arg_link_type, const u_char* arg_data)
+			{
+			ts = arg_ts;
+			caplen = arg_caplen;
+			len = arg_len;
+			link_type = arg_link_type;
+			data.assign(arg_data, arg_data + arg_caplen);
+			}
+		};
+
+	/**
+	 * Constructor.
+	 *
+	 * @param capacity The number of slots in the ring.
+	 */
+	explicit PacketRing(size_t capacity);
+
+	/**
+	 * Returns a free slot for the producer to fill in, to be followed by
+	 * CommitWrite().
+	 *
+	 * @param block If true, waits for a slot to become available if the
+	 * ring is full.
+	 *
+	 * @return The slot, or null if the ring is full and \a block is
+	 * false, or if the consumer has shut the ring down.
+	 */
+	Slot* BeginWrite(bool block);
+
+	/**
+	 * Makes the slot returned by the previous BeginWrite() available to
+	 * the consumer.
+	 */
+	void CommitWrite();
+
+	/**
+	 * Signals that the producer won't write any more packets. The
+	 * consumer can still read everything committed so far.
+	 */
+	void Finish();
+
+	/**
+	 * Returns the next slot for the consumer to read. The slot remains
+	 * valid until released with EndRead().
+	 *
+	 * @param block If true, waits for a packet if none is available.
+	 *
+	 * @return The slot, or null if no packet is available and either
+	 * \a block is false or the producer has finished.
+	 */
+	Slot* BeginRead(bool block);
+
+	/**
+	 * Releases the \a n oldest slots handed out by BeginRead(), making
+	 * them available to the producer again.
+	 */
+	void EndRead(size_t n = 1);
+
+	/**
+	 * Signals that the consumer won't read any more packets. This wakes
+	 * up a producer blocked in BeginWrite().
+	 */
+	void Shutdown();
+
+	/**
+	 * Returns true once the producer has finished and all committed
+	 * packets have been read.
+	 */
+	bool Drained() const;
+
+	/**
+	 * Returns the number of slots in the ring.
+	 */
+	size_t Capacity() const { return slots.size(); }
+
+private:
+	std::vector<Slot> slots;
+
+	mutable std::mutex mtx;
+	std::condition_variable can_write;
+	std::condition_variable can_read;
+
+	// Monotonic counters of slots written, handed out to the consumer,
+	// and released by the consumer.
+	uint64_t written = 0;
+	uint64_t read = 0;
+	uint64_t released = 0;
+
+	bool finished = false;
+	bool shut_down = false;
+	};
+
+	} // namespace zeek::iosource::detail
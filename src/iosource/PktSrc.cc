@@ -154,6 +154,12 @@ void PktSrc::Process()
 	if ( ! IsOpen() )
 		return;
 
+	if ( BatchingEnabled() )
+		{
+		ProcessBatch();
+		return;
+		}
+
 	if ( ! ExtractNextPacketInternal() )
 		return;
 
@@ -219,6 +225,113 @@ bool PktSrc::ExtractNextPacketInternal()
 	return false;
 	}
 
+bool PktSrc::BatchingEnabled() const
+	{
+	// Pseudo-realtime mode needs to look at each packet's timestamp
+	// before deciding whether to process it, so it never batches.
+	return BifConst::Pcap::batch_size > 1 && ! run_state::pseudo_realtime;
+	}
+
+size_t PktSrc::ExtractNextPacketBatch(Packet* pkts, size_t max)
+	{
+	if ( max == 0 )
+		return 0;
+
+	return ExtractNextPacket(&pkts[0]) ? 1 : 0;
+	}
+
+void PktSrc::DoneWithPacketBatch()
+	{
+	DoneWithPacket();
+	}
+
+bool PktSrc::ExtractNextPacketBatchInternal()
+	{
+	if ( batch_pos < batch_len )
+		return true;
+
+	// Same as in ExtractNextPacketInternal(): no packets while
+	// processing is suspended, except for the very first one.
+	if ( run_state::is_processing_suspended() && run_state::detail::first_timestamp )
+		return false;
+
+	if ( ! batch )
+		{
+		batch_capacity = BifConst::Pcap::batch_size;
+		batch = std::make_unique<Packet[]>(batch_capacity);
+		}
+
+	batch_pos = 0;
+	batch_len = ExtractNextPacketBatch(batch.get(), batch_capacity);
+
+	if ( batch_len > 0 )
+		{
+		had_packet = true;
+		return true;
+		}
+
+	if ( had_packet )
+		{
+		DBG_LOG(DBG_PKTIO, "source %s is idle now", props.path.c_str());
+		idle_at_wallclock = zeek::util::current_time(true);
+		}
+
+	had_packet = false;
+	return false;
+	}
+
+void PktSrc::ProcessBatch()
+	{
+	if ( ! ExtractNextPacketBatchInternal() )
+		return;
+
+	while ( batch_pos < batch_len )
+		{
+		// A script may suspend processing while we work through the
+		// batch. Keep the remaining packets around until it resumes.
+		if ( run_state::is_processing_suspended() && run_state::detail::first_timestamp )
+			return;
+
+		// The source may also have been closed from within a handler,
+		// in which case the rest of the batch is discarded.
+		if ( ! IsOpen() )
+			break;
+
+		Packet* pkt = &batch[batch_pos++];
+
+		if ( pkt->time < 0 )
+			{
+			Weird("negative_packet_timestamp", pkt);
+			continue;
+			}
+
+		if ( ! run_state::detail::first_timestamp )
+			run_state::detail::first_timestamp = pkt->time;
+
+		current_batch_packet = pkt;
+		have_packet = true;
+
+		// Get the next packet's session entry into the cache while we
+		// work on this one.
+		if ( batch_pos < batch_len )
+			packet_mgr->PrefetchSession(&batch[batch_pos]);
+
+		run_state::detail::dispatch_packet(pkt, this);
+
+		// Drop the per-packet analysis state right away instead of when
+		// the slot gets reused, so that the IP and tunnel analyzers can
+		// recycle it for the next packet in the batch.
+		pkt->ip_hdr.reset();
+		pkt->encap.reset();
+
+		have_packet = false;
+		current_batch_packet = nullptr;
+		}
+
+	batch_len = batch_pos = 0;
+	DoneWithPacketBatch();
+	}
+
 detail::BPF_Program* PktSrc::CompileFilter(const std::string& filter)
 	{
 	auto code = std::make_unique<detail::BPF_Program>();
@@ -288,7 +401,7 @@ bool PktSrc::GetCurrentPacket(const Packet** pkt)
 	if ( ! have_packet )
 		return false;
 
-	*pkt = &current_packet;
+	*pkt = current_batch_packet ? current_batch_packet : &current_packet;
 	return true;
 	}
 
@@ -319,6 +432,10 @@ double PktSrc::GetNextTimeout()
 	// A heuristic to avoid short sleeps when a non-selectable packet source has more
 	// packets queued is to return 0.0 if the source has yielded a packet on the
 	// last call to ExtractNextPacket().
+	// Packets left over from a batch are ready to go right away.
+	if ( batch_pos < batch_len )
+		return 0.0;
+
 	if ( props.selectable_fd == -1 )
 		{
 		if ( have_packet || had_packet )
@@ -3,6 +3,7 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -358,6 +359,37 @@ protected:
 	 */
 	virtual void DoneWithPacket() = 0;
 
+	/**
+	 * Provides up to \a max packets from the source in one go. This is
+	 * used instead of \a ExtractNextPacket() when batching has been
+	 * enabled through \c Pcap::batch_size.
+	 *
+	 * The default implementation falls back to \a ExtractNextPacket()
+	 * and returns at most a single packet. Sources that can hand out
+	 * multiple packets at once should override this, along with \a
+	 * DoneWithPacketBatch().
+	 *
+	 * @param pkts An array of at least \a max packet structures to fill
+	 * in. As with \a ExtractNextPacket(), the callee keeps ownership of
+	 * the data but must guarantee that it stays available for all of
+	 * the returned packets until \a DoneWithPacketBatch() is called.
+	 *
+	 * @param max The maximum number of packets to extract.
+	 *
+	 * @return The number of packets filled in, starting at \a pkts[0].
+	 * Zero if no packet is available or an error occurred (which must
+	 * be flagged via Error()).
+	 */
+	virtual size_t ExtractNextPacketBatch(Packet* pkts, size_t max);
+
+	/**
+	 * Signals that the data of all packets returned by the previous
+	 * call to \a ExtractNextPacketBatch() will no longer be needed.
+	 *
+	 * The default implementation calls \a DoneWithPacket().
+	 */
+	virtual void DoneWithPacketBatch();
+
 	/**
 	 * Performs the actual filter compilation. This can be overridden to
 	 * provide a different implementation of the compilation called by
@@ -374,6 +406,11 @@ private:
 	// Internal helper for ExtractNextPacket().
 	bool ExtractNextPacketInternal();
 
+	// Internal helpers for batched extraction and processing.
+	bool ExtractNextPacketBatchInternal();
+	void ProcessBatch();
+	bool BatchingEnabled() const;
+
 	// IOSource interface implementation.
 	void InitSource() override;
 	void Done() override;
@@ -389,6 +426,17 @@ private:
 
 	double idle_at_wallclock = 0.0;
 
+	// State for batched extraction. The batch array is allocated on
+	// first use with batch_capacity entries. Packets [batch_pos,
+	// batch_len) have not been dispatched yet.
+	std::unique_ptr<Packet[]> batch;
+	size_t batch_capacity = 0;
+	size_t batch_len = 0;
+	size_t batch_pos = 0;
+
+	// The packet GetCurrentPacket() reports while batching is active.
+	Packet* current_batch_packet = nullptr;
+
 	// For BPF filtering support.
 	std::vector<detail::BPF_Program*> filters;
 
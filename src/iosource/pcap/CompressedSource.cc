@@ -0,0 +1,505 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "zeek/iosource/pcap/CompressedSource.h"
+
+#include "zeek/zeek-config.h"
+
+#include <pcap.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "zeek/Event.h"
+#include "zeek/iosource/BPF_Program.h"
+#include "zeek/iosource/Packet.h"
+#include "zeek/iosource/pcap/pcap.bif.h"
+
+namespace zeek::iosource::pcap
+	{
+
+namespace detail
+	{
+
+/**
+ * Interface for the supported compression formats.
+ */
+class Decompressor
+	{
+public:
+	virtual ~Decompressor() = default;
+
+	/**
+	 * Reads up to \a len bytes of decompressed data.
+	 *
+	 * @return The number of bytes read, 0 at the end of the input, or -1
+	 * on error with ErrorMsg() set.
+	 */
+	virtual ssize_t Read(u_char* buf, size_t len) = 0;
+
+	const std::string& ErrorMsg() const { return error; }
+
+protected:
+	std::string error;
+	};
+
+class GzipDecompressor : public Decompressor
+	{
+public:
+	explicit GzipDecompressor(gzFile arg_file) : file(arg_file)
+		{
+		// Larger than zlib's default of 8K to cut down on read calls.
+		gzbuffer(file, 256 * 1024);
+		}
+
+	~GzipDecompressor() override { gzclose(file); }
+
+	ssize_t Read(u_char* buf, size_t len) override
+		{
+		int n = gzread(file, buf, static_cast<unsigned int>(len));
+
+		if ( n < 0 )
+			{
+			int errnum;
+			error = gzerror(file, &errnum);
+			return -1;
+			}
+
+		return n;
+		}
+
+private:
+	gzFile file;
+	};
+
+#ifdef USE_ZSTD
+class ZstdDecompressor : public Decompressor
+	{
+public:
+	explicit ZstdDecompressor(FILE* arg_file)
+		: file(arg_file), stream(ZSTD_createDStream()), inbuf(ZSTD_DStreamInSize())
+		{
+		ZSTD_initDStream(stream);
+		}
+
+	~ZstdDecompressor() override
+		{
+		ZSTD_freeDStream(stream);
+		fclose(file);
+		}
+
+	ssize_t Read(u_char* buf, size_t len) override
+		{
+		ZSTD_outBuffer out = {buf, len, 0};
+
+		while ( out.pos == 0 )
+			{
+			if ( in.pos == in.size )
+				{
+				in.src = inbuf.data();
+				in.size = fread(inbuf.data(), 1, inbuf.size(), file);
+				in.pos = 0;
+
+				if ( in.size == 0 )
+					{
+					if ( ferror(file) )
+						{
+						error = strerror(errno);
+						return -1;
+						}
+
+					if ( last_ret != 0 )
+						{
+						error = "truncated zstd stream";
+						return -1;
+						}
+
+					return 0;
+					}
+				}
+
+			size_t ret = ZSTD_decompressStream(stream, &out, &in);
+
+			if ( ZSTD_isError(ret) )
+				{
+				error = ZSTD_getErrorName(ret);
+				return -1;
+				}
+
+			last_ret = ret;
+			}
+
+		return static_cast<ssize_t>(out.pos);
+		}
+
+private:
+	FILE* file;
+	ZSTD_DStream* stream;
+	std::vector<u_char> inbuf;
+	ZSTD_inBuffer in = {nullptr, 0, 0};
+	size_t last_ret = 0;
+	};
+#endif
+
+	} // namespace detail
+
+// Size of the initial decompression buffer. It grows if a single record
+// doesn't fit.
+static constexpr size_t READ_BUFFER_SIZE = 1024 * 1024;
+
+CompressedSource::CompressedSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	}
+
+CompressedSource::~CompressedSource()
+	{
+	Close();
+	}
+
+bool CompressedSource::IsCompressed(const std::string& path)
+	{
+	// Reading from a pipe or other stream would consume the bytes we look
+	// at, and libpcap then wouldn't get to see them.
+	struct stat st;
+
+	if ( stat(path.c_str(), &st) < 0 || ! S_ISREG(st.st_mode) )
+		return false;
+
+	FILE* f = fopen(path.c_str(), "rb");
+
+	if ( ! f )
+		return false;
+
+	u_char magic[4];
+	size_t n = fread(magic, 1, sizeof(magic), f);
+	fclose(f);
+
+	if ( n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b )
+		return true;
+
+#ifdef USE_ZSTD
+	if ( n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd )
+		return true;
+#endif
+
+	return false;
+	}
+
+void CompressedSource::Open()
+	{
+	FILE* f = fopen(props.path.c_str(), "rb");
+
+	if ( ! f )
+		{
+		Error(util::fmt("%s: %s", props.path.c_str(), strerror(errno)));
+		return;
+		}
+
+	u_char magic[4] = {0};
+	size_t n = fread(magic, 1, sizeof(magic), f);
+	rewind(f);
+
+	if ( n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b )
+		{
+		// zlib wants a descriptor of its own, which gzclose() will close.
+		int fd = dup(fileno(f));
+		fclose(f);
+
+		gzFile gz = fd >= 0 ? gzdopen(fd, "rb") : nullptr;
+
+		if ( ! gz )
+			{
+			if ( fd >= 0 )
+				close(fd);
+
+			Error(util::fmt("%s: cannot open gzip stream", props.path.c_str()));
+			return;
+			}
+
+		decompressor = std::make_unique<detail::GzipDecompressor>(gz);
+		}
+#ifdef USE_ZSTD
+	else if ( n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f &&
+	          magic[3] == 0xfd )
+		decompressor = std::make_unique<detail::ZstdDecompressor>(f);
+#endif
+	else
+		{
+		fclose(f);
+		Error(util::fmt("%s: unknown compression format", props.path.c_str()));
+		return;
+		}
+
+	ring = std::make_unique<iosource::detail::PacketRing>(BifConst::Pcap::decompress_ring_size);
+	thread = std::thread(&CompressedSource::Run, this);
+
+	// Wait for the first packet to learn the trace's link type.
+	first_slot = ring->BeginRead(true);
+
+	int link_type = first_slot ? first_slot->link_type : parser.LinkType();
+
+	if ( ! first_slot && ! thread_error.empty() )
+		{
+		Error(util::fmt("%s: %s", props.path.c_str(), thread_error.c_str()));
+		Close();
+		return;
+		}
+
+	if ( link_type < 0 )
+		{
+		Error(util::fmt("%s: no link type found in trace", props.path.c_str()));
+		Close();
+		return;
+		}
+
+	props.selectable_fd = -1;
+	props.link_type = link_type;
+	props.is_live = false;
+
+	Opened(props);
+	}
+
+void CompressedSource::Close()
+	{
+	if ( ! ring )
+		return;
+
+	ring->Shutdown();
+
+	if ( thread.joinable() )
+		thread.join();
+
+	ring.reset();
+	decompressor.reset();
+	first_slot = nullptr;
+	outstanding = 0;
+
+	if ( ! IsOpen() )
+		return;
+
+	Closed();
+
+	if ( Pcap::file_done )
+		event_mgr.Enqueue(Pcap::file_done, make_intrusive<StringVal>(props.path));
+	}
+
+void CompressedSource::Run()
+	{
+	std::vector<u_char> buf(READ_BUFFER_SIZE);
+	size_t start = 0;
+	size_t end = 0;
+	bool eof = false;
+
+	while ( true )
+		{
+		detail::TraceParser::Record rec;
+		size_t consumed;
+
+		auto res = parser.Next(buf.data() + start, end - start, &consumed, &rec);
+		start += consumed;
+
+		if ( res == detail::TraceParser::Result::Packet )
+			{
+			auto* slot = ring->BeginWrite(true);
+
+			if ( ! slot )
+				// The main thread is shutting us down.
+				break;
+
+			slot->Assign(rec.ts, rec.caplen, rec.len, rec.link_type, rec.data);
+			ring->CommitWrite();
+			continue;
+			}
+
+		if ( res == detail::TraceParser::Result::Error )
+			{
+			thread_error = parser.ErrorMsg();
+			break;
+			}
+
+		// Need more data.
+		if ( eof )
+			{
+			if ( start < end )
+				thread_error = "truncated trace";
+			break;
+			}
+
+		if ( start > 0 )
+			{
+			memmove(buf.data(), buf.data() + start, end - start);
+			end -= start;
+			start = 0;
+			}
+
+		if ( end == buf.size() )
+			buf.resize(buf.size() * 2);
+
+		ssize_t n = decompressor->Read(buf.data() + end, buf.size() - end);
+
+		if ( n < 0 )
+			{
+			thread_error = decompressor->ErrorMsg();
+			break;
+			}
+
+		if ( n == 0 )
+			eof = true;
+		else
+			end += n;
+		}
+
+	ring->Finish();
+	}
+
+bool CompressedSource::NextSlot(Packet* pkt, bool block)
+	{
+	while ( ring )
+		{
+		iosource::detail::PacketRing::Slot* slot = first_slot;
+		first_slot = nullptr;
+
+		if ( ! slot )
+			slot = ring->BeginRead(block);
+
+		if ( ! slot )
+			{
+			if ( ring->Drained() && ! thread_error.empty() )
+				reporter->FatalError("failed to read a packet from %s: %s", props.path.data(),
+				                     thread_error.c_str());
+			return false;
+			}
+
+		if ( slot->link_type != props.link_type )
+			reporter->FatalError("failed to read a packet from %s: interfaces with different "
+			                     "link types are not supported",
+			                     props.path.data());
+
+		pkt->Init(props.link_type, &slot->ts, slot->caplen, slot->len, slot->data.data());
+
+		bool skip = false;
+
+		if ( slot->len == 0 || slot->caplen == 0 )
+			{
+			Weird("empty_pcap_header", pkt);
+			skip = true;
+			}
+		else if ( current_filter >= 0 )
+			{
+			struct pcap_pkthdr hdr;
+			hdr.ts = slot->ts;
+			hdr.caplen = slot->caplen;
+			hdr.len = slot->len;
+			skip = ! ApplyBPFFilter(current_filter, &hdr, slot->data.data());
+
+			if ( ! ring )
+				// Filter error closed the source.
+				return false;
+			}
+
+		if ( skip )
+			{
+			// Slots need to be released in order. If nothing is
+			// outstanding we can give this one back right away,
+			// otherwise it goes back along with the others.
+			if ( outstanding == 0 )
+				ring->EndRead(1);
+			else
+				++outstanding;
+
+			continue;
+			}
+
+		++outstanding;
+		++stats.received;
+		stats.bytes_received += slot->len;
+		return true;
+		}
+
+	return false;
+	}
+
+bool CompressedSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( NextSlot(pkt, true) )
+		return true;
+
+	Close();
+	return false;
+	}
+
+void CompressedSource::DoneWithPacket()
+	{
+	DoneWithPacketBatch();
+	}
+
+size_t CompressedSource::ExtractNextPacketBatch(Packet* pkts, size_t max)
+	{
+	if ( max == 0 )
+		return 0;
+
+	if ( ! NextSlot(&pkts[0], true) )
+		{
+		Close();
+		return 0;
+		}
+
+	// Take whatever else is ready without waiting for the thread.
+	size_t n = 1;
+
+	while ( n < max && NextSlot(&pkts[n], false) )
+		++n;
+
+	return n;
+	}
+
+void CompressedSource::DoneWithPacketBatch()
+	{
+	if ( ring && outstanding > 0 )
+		ring->EndRead(outstanding);
+
+	outstanding = 0;
+	}
+
+bool CompressedSource::SetFilter(int index)
+	{
+	if ( ! ring )
+		return true; // Prevent error message
+
+	iosource::detail::BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(util::fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	if ( code->GetState() == FilterState::FATAL )
+		return false;
+
+	current_filter = index;
+	return true;
+	}
+
+void CompressedSource::Statistics(Stats* s)
+	{
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->link = 0;
+	s->dropped = 0;
+	}
+
+iosource::PktSrc* CompressedSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new CompressedSource(path, is_live);
+	}
+
+	} // namespace zeek::iosource::pcap
@@ -0,0 +1,88 @@
+// See the file  in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "zeek/iosource/PacketRing.h"
+#include "zeek/iosource/PktSrc.h"
+#include "zeek/iosource/pcap/TraceParser.h"
+
+namespace zeek::iosource::pcap
+	{
+
+namespace detail
+	{
+class Decompressor;
+	}
+
+/**
+ * Offline packet source for gzip- or zstd-compressed pcap and pcapng
+ * traces. A separate thread decompresses and parses the trace into a
+ * bounded ring of packet buffers, so that decompression overlaps with
+ * packet processing on the main thread.
+ *
+ * The pcap reader hands compressed files off to this source
+ * automatically, see PcapSource::Instantiate().
+ */
+class CompressedSource : public PktSrc
+	{
+public:
+	CompressedSource(const std::string& path, bool is_live);
+	~CompressedSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+	/**
+	 * Returns true if the file at the given path starts with a gzip or
+	 * (if support has been compiled in) zstd magic number. Anything but
+	 * a regular file, such as a pipe, counts as not compressed without
+	 * reading from it.
+	 */
+	static bool IsCompressed(const std::string& path);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	size_t ExtractNextPacketBatch(Packet* pkts, size_t max) override;
+	void DoneWithPacketBatch() override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// Body of the decompression thread.
+	void Run();
+
+	// Takes the next slot from the ring that passes the current filter
+	// and initializes pkt from it. Returns false at the end of the trace.
+	bool NextSlot(Packet* pkt, bool block);
+
+	Properties props;
+	Stats stats;
+
+	std::unique_ptr<detail::Decompressor> decompressor;
+	std::unique_ptr<iosource::detail::PacketRing> ring;
+	std::thread thread;
+
+	// Only accessed by the decompression thread until it calls
+	// PacketRing::Finish().
+	detail::TraceParser parser;
+	std::string thread_error;
+
+	// Slot read ahead during Open() to determine the link type.
+	iosource::detail::PacketRing::Slot* first_slot = nullptr;
+
+	// Number of slots handed out to the main thread but not released.
+	size_t outstanding = 0;
+
+	// Index of the active filter, or -1 if none.
+	int current_filter = -1;
+	};
+
+	} // namespace zeek::iosource::pcap
@@ -4,10 +4,13 @@
 
 #include <sys/stat.h>
 #include <cerrno>
+#include <cinttypes>
 
+#include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/iosource/PktSrc.h"
 #include "zeek/iosource/pcap/pcap.bif.h"
+#include "zeek/telemetry/Manager.h"
 
 namespace zeek::iosource::pcap
 	{
@@ -20,6 +23,11 @@ PcapDumper::PcapDumper(const std::string& path, bool arg_append)
 	pd = nullptr;
 	}
 
+PcapDumper::~PcapDumper()
+	{
+	Close();
+	}
+
 void PcapDumper::Open()
 	{
 	int linktype = -1;
@@ -53,7 +61,15 @@ void PcapDumper::Open()
 			}
 		}
 
-	if ( ! append || exists < 0 || s.st_size == 0 )
+	bool new_file = ! append || exists < 0 || s.st_size == 0;
+
+	if ( BifConst::Pcap::async_dump )
+		{
+		if ( ! OpenBuffered(new_file) )
+			return;
+		}
+
+	else if ( new_file )
 		{
 		// Open new file.
 		dumper = pcap_dump_open(pd, props.path.c_str());
@@ -82,15 +98,80 @@ void PcapDumper::Open()
 			}
 		}
 
+	if ( BifConst::Pcap::async_dump )
+		{
+		static auto dropped_family = telemetry_mgr->CounterFamily(
+			"zeek", "pcap-dumper-dropped-packets", {"path"},
+			"Number of packets an asynchronous packet dumper dropped due to a full buffer",
+			"1", true);
+
+		dropped = dropped_family.GetOrAdd({{"path", props.path}});
+		num_dropped = 0;
+
+		ring = std::make_unique<iosource::detail::PacketRing>(
+			BifConst::Pcap::async_dump_ring_size);
+		writer = std::thread(&PcapDumper::Run, this);
+		}
+
 	props.open_time = run_state::network_time;
 	Opened(props);
 	}
 
+bool PcapDumper::OpenBuffered(bool new_file)
+	{
+	// We open the file ourselves to give stdio a large buffer, so that
+	// the writer thread produces big sequential writes. That has to
+	// happen before anything gets written to the file, which rules out
+	// pcap_dump_open() as it writes the file header right away.
+	FILE* f = fopen(props.path.c_str(), new_file ? "w" : "a");
+
+	if ( ! f )
+		{
+		Error(util::fmt("can't open dump %s: %s", props.path.c_str(), strerror(errno)));
+		return false;
+		}
+
+	static constexpr size_t file_buffer_size = 1024 * 1024;
+	file_buffer = std::make_unique<char[]>(file_buffer_size);
+	setvbuf(f, file_buffer.get(), _IOFBF, file_buffer_size);
+
+	if ( new_file )
+		{
+		dumper = pcap_dump_fopen(pd, f);
+
+		if ( ! dumper )
+			{
+			Error(pcap_geterr(pd));
+			fclose(f);
+			return false;
+			}
+		}
+	else
+		// libpcap can only append to files it opens itself, so we use
+		// the same approach as Open() does without
+		// pcap_dump_open_append(): a pcap_dumper_t is in fact a FILE.
+		dumper = (pcap_dumper_t*)f;
+
+	return true;
+	}
+
 void PcapDumper::Close()
 	{
 	if ( ! dumper )
 		return;
 
+	if ( ring )
+		{
+		// Let the writer drain what's buffered before closing.
+		ring->Finish();
+		writer.join();
+		ring.reset();
+
+		if ( num_dropped > 0 )
+			reporter->Warning("packet dumper %s dropped %" PRIu64 " packets due to a full buffer",
+			                  props.path.c_str(), num_dropped);
+		}
+
 	pcap_dump_close(dumper);
 	pcap_close(pd);
 	dumper = nullptr;
@@ -104,6 +185,24 @@ bool PcapDumper::Dump(const Packet* pkt)
 	if ( ! dumper )
 		return false;
 
+	if ( ring )
+		{
+		// When reading traces, wait for the writer rather than dropping
+		// packets, so that output stays deterministic.
+		auto* slot = ring->BeginWrite(! run_state::reading_live);
+
+		if ( ! slot )
+			{
+			++num_dropped;
+			dropped->Inc();
+			return true;
+			}
+
+		slot->Assign(pkt->ts, pkt->cap_len, pkt->len, pkt->link_type, pkt->data);
+		ring->CommitWrite();
+		return true;
+		}
+
 	// Reconstitute the pcap_pkthdr.
 	const struct pcap_pkthdr phdr = {pkt->ts, pkt->cap_len, pkt->len};
 
@@ -112,6 +211,36 @@ bool PcapDumper::Dump(const Packet* pkt)
 	return true;
 	}
 
+void PcapDumper::Run()
+	{
+	while ( auto* slot = ring->BeginRead(true) )
+		{
+		size_t n = 0;
+
+		// Write everything that's queued up, then flush once the ring
+		// runs empty so that the file is current while we're idle.
+		do
+			{
+			const struct pcap_pkthdr phdr = {slot->ts, slot->caplen, slot->len};
+			pcap_dump((u_char*)dumper, &phdr, slot->data.data());
+			++n;
+
+			// Release in chunks so the producer isn't starved of
+			// slots while we work through a long backlog.
+			if ( n == 64 )
+				{
+				ring->EndRead(n);
+				n = 0;
+				}
+			} while ( (slot = ring->BeginRead(false)) );
+
+		if ( n > 0 )
+			ring->EndRead(n);
+
+		pcap_dump_flush(dumper);
+		}
+	}
+
 iosource::PktDumper* PcapDumper::Instantiate(const std::string& path, bool append)
 	{
 	return new PcapDumper(path, append);
@@ -3,13 +3,18 @@
 #pragma once
 
 #include <unistd.h>
+#include <memory>
+#include <optional>
+#include <thread>
 
 extern "C"
 	{
 #include <pcap.h>
 	}
 
+#include "zeek/iosource/PacketRing.h"
 #include "zeek/iosource/PktDumper.h"
+#include "zeek/telemetry/Counter.h"
 
 namespace zeek::iosource::pcap
 	{
@@ -18,7 +23,7 @@ class PcapDumper : public PktDumper
 	{
 public:
 	PcapDumper(const std::string& path, bool append);
-	~PcapDumper() override = default;
+	~PcapDumper() override;
 
 	static PktDumper* Instantiate(const std::string& path, bool append);
 
@@ -29,11 +34,27 @@ protected:
 	bool Dump(const Packet* pkt) override;
 
 private:
+	// Opens the output file with a large stdio buffer, for asynchronous
+	// mode. Returns false if that fails, after reporting the error.
+	bool OpenBuffered(bool new_file);
+
+	// Body of the writer thread in asynchronous mode.
+	void Run();
+
 	Properties props;
 
 	bool append;
 	pcap_dumper_t* dumper;
 	pcap_t* pd;
+
+	// Asynchronous mode (Pcap::async_dump): packets are copied into the
+	// ring by Dump() and written out by a separate thread, so that the
+	// main thread doesn't block on disk I/O.
+	std::unique_ptr<iosource::detail::PacketRing> ring;
+	std::thread writer;
+	std::unique_ptr<char[]> file_buffer;
+	std::optional<telemetry::IntCounter> dropped;
+	uint64_t num_dropped = 0;
 	};
 
 	} // namespace zeek::iosource::pcap
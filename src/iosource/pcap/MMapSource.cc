@@ -0,0 +1,286 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "zeek/iosource/pcap/MMapSource.h"
+
+#include "zeek/zeek-config.h"
+
+#include <fcntl.h>
+#include <pcap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+#include "zeek/Event.h"
+#include "zeek/iosource/BPF_Program.h"
+#include "zeek/iosource/Packet.h"
+#include "zeek/iosource/pcap/pcap.bif.h"
+
+namespace zeek::iosource::pcap
+	{
+
+// Granularity at which we hand consumed parts of the mapping back to the
+// kernel.
+static constexpr size_t RELEASE_CHUNK = 64 * 1024 * 1024;
+
+MMapSource::MMapSource(const std::string& path, bool is_live)
+	{
+	props.path = path;
+	props.is_live = is_live;
+	}
+
+MMapSource::~MMapSource()
+	{
+	Close();
+	}
+
+void MMapSource::Open()
+	{
+	if ( props.is_live )
+		{
+		Error("mmap packet source does not support live capture");
+		return;
+		}
+
+	fd = open(props.path.c_str(), O_RDONLY);
+
+	if ( fd < 0 )
+		{
+		Error(util::fmt("%s: %s", props.path.c_str(), strerror(errno)));
+		return;
+		}
+
+	struct stat st;
+
+	if ( fstat(fd, &st) < 0 || ! S_ISREG(st.st_mode) )
+		{
+		Error(util::fmt("%s: not a regular file, cannot mmap", props.path.c_str()));
+		close(fd);
+		fd = -1;
+		return;
+		}
+
+	map_len = st.st_size;
+
+	if ( map_len == 0 )
+		{
+		Error(util::fmt("%s: empty trace file", props.path.c_str()));
+		close(fd);
+		fd = -1;
+		return;
+		}
+
+	void* addr = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if ( addr == MAP_FAILED )
+		{
+		Error(util::fmt("%s: mmap failed: %s", props.path.c_str(), strerror(errno)));
+		close(fd);
+		fd = -1;
+		return;
+		}
+
+	map = static_cast<const u_char*>(addr);
+
+#ifdef MADV_SEQUENTIAL
+	// Ask for aggressive read-ahead; failure is harmless.
+	madvise(addr, map_len, MADV_SEQUENTIAL);
+#endif
+
+	if ( ! detail::TraceParser::LooksLikeTrace(map, map_len) )
+		{
+		Error(util::fmt("%s: unknown file format", props.path.c_str()));
+		Close();
+		return;
+		}
+
+	// Parse up to the first packet to learn the link type, then start
+	// over so that the packet gets returned normally.
+	detail::TraceParser probe;
+	detail::TraceParser::Record rec;
+	size_t consumed;
+
+	if ( probe.Next(map, map_len, &consumed, &rec) == detail::TraceParser::Result::Error )
+		{
+		Error(util::fmt("%s: %s", props.path.c_str(), probe.ErrorMsg().c_str()));
+		Close();
+		return;
+		}
+
+	if ( probe.LinkType() < 0 )
+		{
+		Error(util::fmt("%s: no link type found in trace", props.path.c_str()));
+		Close();
+		return;
+		}
+
+	props.selectable_fd = -1;
+	props.link_type = probe.LinkType();
+	props.is_live = false;
+
+	Opened(props);
+	}
+
+void MMapSource::Close()
+	{
+	if ( ! map && fd < 0 )
+		return;
+
+	if ( map )
+		munmap(const_cast<u_char*>(map), map_len);
+
+	if ( fd >= 0 )
+		close(fd);
+
+	map = nullptr;
+	map_len = offset = released = 0;
+	fd = -1;
+
+	if ( ! IsOpen() )
+		return;
+
+	Closed();
+
+	if ( Pcap::file_done )
+		event_mgr.Enqueue(Pcap::file_done, make_intrusive<StringVal>(props.path));
+	}
+
+bool MMapSource::NextRecord(Packet* pkt)
+	{
+	while ( map && offset < map_len )
+		{
+		detail::TraceParser::Record rec;
+		size_t consumed;
+
+		auto res = parser.Next(map + offset, map_len - offset, &consumed, &rec);
+		offset += consumed;
+
+		if ( res == detail::TraceParser::Result::NeedMore )
+			{
+			if ( offset < map_len )
+				reporter->Weird("truncated_pcap_trace");
+			break;
+			}
+
+		if ( res == detail::TraceParser::Result::Error )
+			reporter->FatalError("failed to read a packet from %s: %s", props.path.data(),
+			                     parser.ErrorMsg().c_str());
+
+		if ( rec.link_type != props.link_type )
+			reporter->FatalError("failed to read a packet from %s: interfaces with different "
+			                     "link types are not supported",
+			                     props.path.data());
+
+		pkt->Init(props.link_type, &rec.ts, rec.caplen, rec.len, rec.data);
+
+		if ( rec.len == 0 || rec.caplen == 0 )
+			{
+			Weird("empty_pcap_header", pkt);
+			continue;
+			}
+
+		if ( current_filter >= 0 )
+			{
+			struct pcap_pkthdr hdr;
+			hdr.ts = rec.ts;
+			hdr.caplen = rec.caplen;
+			hdr.len = rec.len;
+
+			if ( ! ApplyBPFFilter(current_filter, &hdr, rec.data) )
+				continue;
+			}
+
+		++stats.received;
+		stats.bytes_received += rec.len;
+		return true;
+		}
+
+	return false;
+	}
+
+bool MMapSource::ExtractNextPacket(Packet* pkt)
+	{
+	if ( NextRecord(pkt) )
+		return true;
+
+	// Exhausted the trace (or closed due to a filter error).
+	Close();
+	return false;
+	}
+
+void MMapSource::DoneWithPacket()
+	{
+	ReleaseConsumed(offset);
+	}
+
+size_t MMapSource::ExtractNextPacketBatch(Packet* pkts, size_t max)
+	{
+	// The whole trace stays mapped, so batching needs no copies.
+	size_t n = 0;
+
+	while ( n < max && NextRecord(&pkts[n]) )
+		++n;
+
+	if ( n == 0 )
+		Close();
+
+	return n;
+	}
+
+void MMapSource::DoneWithPacketBatch()
+	{
+	ReleaseConsumed(offset);
+	}
+
+void MMapSource::ReleaseConsumed(size_t up_to)
+	{
+	if ( ! map || up_to < released + RELEASE_CHUNK )
+		return;
+
+	static const size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t end = up_to - (up_to % page_size);
+
+#ifdef MADV_DONTNEED
+	// The mapping is read-only and file-backed, so the pages would simply
+	// be faulted in again if they were still accessed.
+	madvise(const_cast<u_char*>(map) + released, end - released, MADV_DONTNEED);
+#endif
+
+	released = end;
+	}
+
+bool MMapSource::SetFilter(int index)
+	{
+	if ( ! map )
+		return true; // Prevent error message
+
+	iosource::detail::BPF_Program* code = GetBPFFilter(index);
+
+	if ( ! code )
+		{
+		Error(util::fmt("No precompiled pcap filter for index %d", index));
+		return false;
+		}
+
+	if ( code->GetState() == FilterState::FATAL )
+		return false;
+
+	current_filter = index;
+	return true;
+	}
+
+void MMapSource::Statistics(Stats* s)
+	{
+	s->received = stats.received;
+	s->bytes_received = stats.bytes_received;
+	s->link = 0;
+	s->dropped = 0;
+	}
+
+iosource::PktSrc* MMapSource::Instantiate(const std::string& path, bool is_live)
+	{
+	return new MMapSource(path, is_live);
+	}
+
+	} // namespace zeek::iosource::pcap
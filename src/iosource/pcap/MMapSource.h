@@ -0,0 +1,64 @@
+// See the file  in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+
+#include "zeek/iosource/PktSrc.h"
+#include "zeek/iosource/pcap/TraceParser.h"
+
+namespace zeek::iosource::pcap
+	{
+
+/**
+ * Offline packet source that memory-maps a pcap or pcapng trace and hands
+ * out packets pointing directly into the mapping, without going through
+ * libpcap's buffered reads. Selected with the "mmap" prefix, e.g.
+ * ``zeek -r mmap:trace.pcap``.
+ */
+class MMapSource : public PktSrc
+	{
+public:
+	MMapSource(const std::string& path, bool is_live);
+	~MMapSource() override;
+
+	static PktSrc* Instantiate(const std::string& path, bool is_live);
+
+protected:
+	// PktSrc interface.
+	void Open() override;
+	void Close() override;
+	bool ExtractNextPacket(Packet* pkt) override;
+	void DoneWithPacket() override;
+	size_t ExtractNextPacketBatch(Packet* pkts, size_t max) override;
+	void DoneWithPacketBatch() override;
+	bool SetFilter(int index) override;
+	void Statistics(Stats* stats) override;
+
+private:
+	// Parses the next record that passes the current filter into pkt.
+	// Returns false at the end of the trace or on error.
+	bool NextRecord(Packet* pkt);
+
+	// Releases pages of the mapping that lie entirely before the given
+	// offset, so that RSS doesn't grow with the size of the trace.
+	void ReleaseConsumed(size_t up_to);
+
+	Properties props;
+	Stats stats;
+
+	detail::TraceParser parser;
+
+	int fd = -1;
+	const u_char* map = nullptr;
+	size_t map_len = 0;
+	size_t offset = 0;
+
+	// Offset up to which the mapping has been released already.
+	size_t released = 0;
+
+	// Index of the active filter, or -1 if none.
+	int current_filter = -1;
+	};
+
+	} // namespace zeek::iosource::pcap
@@ -4,6 +4,7 @@
 
 #include "zeek/iosource/Component.h"
 #include "zeek/iosource/pcap/Dumper.h"
+#include "zeek/iosource/pcap/MMapSource.h"
 #include "zeek/iosource/pcap/Source.h"
 
 namespace zeek::plugin::detail::Zeek_Pcap
@@ -17,6 +18,9 @@ public:
 		AddComponent(new iosource::PktSrcComponent("PcapReader", "pcap",
 		                                           iosource::PktSrcComponent::BOTH,
 		                                           iosource::pcap::PcapSource::Instantiate));
+		AddComponent(new iosource::PktSrcComponent("MMapReader", "mmap",
+		                                           iosource::PktSrcComponent::TRACE,
+		                                           iosource::pcap::MMapSource::Instantiate));
 		AddComponent(new iosource::PktDumperComponent("PcapWriter", "pcap",
 		                                              iosource::pcap::PcapDumper::Instantiate));
 
@@ -13,6 +13,7 @@
 #include "zeek/Event.h"
 #include "zeek/iosource/BPF_Program.h"
 #include "zeek/iosource/Packet.h"
+#include "zeek/iosource/pcap/CompressedSource.h"
 #include "zeek/iosource/pcap/pcap.bif.h"
 
 namespace zeek::iosource::pcap
@@ -268,6 +269,86 @@ void PcapSource::DoneWithPacket()
 	// Nothing to do.
 	}
 
+void PcapSource::BatchCallback(u_char* user, const struct pcap_pkthdr* hdr, const u_char* data)
+	{
+	auto* src = reinterpret_cast<PcapSource*>(user);
+
+	if ( ! data )
+		{
+		reporter->Weird("pcap_null_data_packet");
+		return;
+		}
+
+	src->batch_hdrs.push_back(*hdr);
+	src->batch_offsets.push_back(src->batch_data.size());
+	src->batch_data.insert(src->batch_data.end(), data, data + hdr->caplen);
+	}
+
+size_t PcapSource::ExtractNextPacketBatch(Packet* pkts, size_t max)
+	{
+	if ( ! pd )
+		return 0;
+
+	batch_hdrs.clear();
+	batch_offsets.clear();
+	batch_data.clear();
+
+	int res = pcap_dispatch(pd, static_cast<int>(max), BatchCallback,
+	                        reinterpret_cast<u_char*>(this));
+
+	switch ( res )
+		{
+		case PCAP_ERROR_BREAK: // -2
+			return 0;
+		case PCAP_ERROR: // -1
+			if ( props.is_live )
+				reporter->Error("failed to read a packet from %s: %s", props.path.data(),
+				                pcap_geterr(pd));
+			else
+				reporter->FatalError("failed to read a packet from %s: %s", props.path.data(),
+				                     pcap_geterr(pd));
+			return 0;
+		case 0:
+			// Either a live read timed out (ok), or we exhausted the
+			// pcap file.
+			if ( ! props.is_live )
+				Close();
+			return 0;
+		default:
+			break;
+		}
+
+	// Only now that batch_data won't grow anymore can we point the
+	// packets into it.
+	size_t n = 0;
+
+	for ( size_t i = 0; i < batch_hdrs.size() && n < max; ++i )
+		{
+		auto& hdr = batch_hdrs[i];
+		Packet* pkt = &pkts[n];
+
+		pkt->Init(props.link_type, &hdr.ts, hdr.caplen, hdr.len,
+		          batch_data.data() + batch_offsets[i]);
+
+		if ( hdr.len == 0 || hdr.caplen == 0 )
+			{
+			Weird("empty_pcap_header", pkt);
+			continue;
+			}
+
+		++stats.received;
+		stats.bytes_received += hdr.len;
+		++n;
+		}
+
+	return n;
+	}
+
+void PcapSource::DoneWithPacketBatch()
+	{
+	// Nothing to do, the buffers get reset with the next batch.
+	}
+
 detail::BPF_Program* PcapSource::CompileFilter(const std::string& filter)
 	{
 	auto code = std::make_unique<detail::BPF_Program>();
@@ -394,6 +475,12 @@ void PcapSource::PcapError(const char* where)
 
 iosource::PktSrc* PcapSource::Instantiate(const std::string& path, bool is_live)
 	{
+	// libpcap can't read compressed traces itself, hand those off to a
+	// source that decompresses them in a separate thread.  Only regular
+	// files get checked for that, see CompressedSource::IsCompressed().
+	if ( ! is_live && CompressedSource::IsCompressed(path) )
+		return CompressedSource::Instantiate(path, is_live);
+
 	return new PcapSource(path, is_live);
 	}
 
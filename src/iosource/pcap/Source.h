@@ -4,6 +4,7 @@
 
 #include <sys/types.h> // for u_char
 #include <unistd.h>
+#include <vector>
 
 extern "C"
 	{
@@ -29,6 +30,8 @@ protected:
 	void Close() override;
 	bool ExtractNextPacket(Packet* pkt) override;
 	void DoneWithPacket() override;
+	size_t ExtractNextPacketBatch(Packet* pkts, size_t max) override;
+	void DoneWithPacketBatch() override;
 	bool SetFilter(int index) override;
 	void Statistics(Stats* stats) override;
 
@@ -39,6 +42,20 @@ private:
 	void OpenOffline();
 	void PcapError(const char* where = nullptr);
 
+	// Callback for pcap_dispatch() that appends a packet to the batch
+	// buffers below.
+	static void BatchCallback(u_char* user, const struct pcap_pkthdr* hdr, const u_char* data);
+
+	// libpcap only guarantees a packet's data to be valid until the
+	// next packet is read, so batched packets are copied back-to-back
+	// into batch_data. The buffers are reused across batches. We can't
+	// process the packets from within the callback instead, because a
+	// script may suspend processing in the middle of a batch, in which
+	// case the remaining packets need to stick around.
+	std::vector<pcap_pkthdr> batch_hdrs;
+	std::vector<size_t> batch_offsets;
+	std::vector<u_char> batch_data;
+
 	Properties props;
 	Stats stats;
 
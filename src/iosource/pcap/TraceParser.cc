@@ -0,0 +1,474 @@
+// See the file  in the main distribution directory for copyright.
+
+#include "zeek/iosource/pcap/TraceParser.h"
+
+#include "zeek/zeek-config.h"
+
+#include <pcap.h>
+#include <algorithm>
+#include <cstring>
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/util.h"
+
+namespace zeek::iosource::pcap::detail
+	{
+
+namespace
+	{
+
+constexpr uint32_t PCAP_MAGIC_USEC = 0xa1b2c3d4;
+constexpr uint32_t PCAP_MAGIC_NSEC = 0xa1b23c4d;
+constexpr uint32_t PCAP_FILE_HEADER_LEN = 24;
+constexpr uint32_t PCAP_RECORD_HEADER_LEN = 16;
+
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+constexpr uint32_t PCAPNG_SECTION_HEADER_BLOCK = 0x0a0d0d0a;
+constexpr uint32_t PCAPNG_INTERFACE_DESCRIPTION_BLOCK = 1;
+constexpr uint32_t PCAPNG_PACKET_BLOCK = 2;
+constexpr uint32_t PCAPNG_SIMPLE_PACKET_BLOCK = 3;
+constexpr uint32_t PCAPNG_ENHANCED_PACKET_BLOCK = 6;
+constexpr uint16_t PCAPNG_OPT_ENDOFOPT = 0;
+constexpr uint16_t PCAPNG_OPT_IF_TSRESOL = 9;
+
+// Largest pcapng block we accept: a maximum-sized packet plus headroom
+// for block headers and options.
+constexpr uint32_t PCAPNG_MAX_BLOCK_LEN = TraceParser::MAX_CAPLEN + 64 * 1024;
+
+uint32_t bswap32(uint32_t v)
+	{
+	return ((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24);
+	}
+
+uint16_t bswap16(uint16_t v)
+	{
+	return static_cast<uint16_t>((v << 8) | (v >> 8));
+	}
+
+uint32_t native32(const u_char* p)
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+	}
+
+// Maps the LINKTYPE_* values stored in trace files to the platform's DLT_*
+// values where the two differ, like libpcap does internally.
+int linktype_to_dlt(uint32_t linktype)
+	{
+	switch ( linktype )
+		{
+		case 101: // LINKTYPE_RAW
+			return DLT_RAW;
+#ifdef DLT_LOOP
+		case 108: // LINKTYPE_LOOP
+			return DLT_LOOP;
+#endif
+		default:
+			return static_cast<int>(linktype);
+		}
+	}
+
+	} // namespace
+
+bool TraceParser::LooksLikeTrace(const u_char* buf, size_t len)
+	{
+	if ( len < 4 )
+		return false;
+
+	uint32_t magic = native32(buf);
+
+	return magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC ||
+	       magic == bswap32(PCAP_MAGIC_USEC) || magic == bswap32(PCAP_MAGIC_NSEC) ||
+	       magic == PCAPNG_SECTION_HEADER_BLOCK;
+	}
+
+uint32_t TraceParser::Get32(const u_char* p) const
+	{
+	uint32_t v = native32(p);
+	return swapped ? bswap32(v) : v;
+	}
+
+uint16_t TraceParser::Get16(const u_char* p) const
+	{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? bswap16(v) : v;
+	}
+
+TraceParser::Result TraceParser::Fail(const std::string& msg)
+	{
+	error = msg;
+	return Result::Error;
+	}
+
+TraceParser::Result TraceParser::Next(const u_char* buf, size_t len, size_t* consumed,
+                                      Record* rec)
+	{
+	*consumed = 0;
+
+	if ( format == Format::Unknown )
+		{
+		if ( len < 4 )
+			return Result::NeedMore;
+
+		if ( ! LooksLikeTrace(buf, len) )
+			return Fail("unknown file format");
+
+		format = native32(buf) == PCAPNG_SECTION_HEADER_BLOCK ? Format::PcapNG : Format::Pcap;
+
+		if ( format == Format::Pcap )
+			{
+			auto res = ParseFileHeader(buf, len, consumed);
+			if ( res != Result::Packet )
+				{
+				if ( res == Result::NeedMore )
+					format = Format::Unknown;
+				return res;
+				}
+			}
+		}
+
+	size_t off = *consumed;
+	Result res;
+
+	if ( format == Format::Pcap )
+		res = NextPcap(buf + off, len - off, consumed, rec);
+	else
+		res = NextPcapNG(buf + off, len - off, consumed, rec);
+
+	*consumed += off;
+	return res;
+	}
+
+TraceParser::Result TraceParser::ParseFileHeader(const u_char* buf, size_t len, size_t* consumed)
+	{
+	if ( len < PCAP_FILE_HEADER_LEN )
+		return Result::NeedMore;
+
+	uint32_t magic = native32(buf);
+	swapped = (magic == bswap32(PCAP_MAGIC_USEC) || magic == bswap32(PCAP_MAGIC_NSEC));
+	nsec = (magic == PCAP_MAGIC_NSEC || magic == bswap32(PCAP_MAGIC_NSEC));
+
+	uint16_t major = Get16(buf + 4);
+	if ( major != 2 )
+		return Fail(util::fmt("unsupported pcap version %u", major));
+
+	snaplen = Get32(buf + 16);
+	// The upper bits of the link type field carry FCS information.
+	link_type = linktype_to_dlt(Get32(buf + 20) & 0x03ffffff);
+
+	*consumed = PCAP_FILE_HEADER_LEN;
+	return Result::Packet;
+	}
+
+TraceParser::Result TraceParser::NextPcap(const u_char* buf, size_t len, size_t* consumed,
+                                          Record* rec)
+	{
+	*consumed = 0;
+
+	if ( len < PCAP_RECORD_HEADER_LEN )
+		return Result::NeedMore;
+
+	uint32_t sec = Get32(buf);
+	uint32_t frac = Get32(buf + 4);
+	uint32_t caplen = Get32(buf + 8);
+	uint32_t wirelen = Get32(buf + 12);
+
+	if ( caplen > MAX_CAPLEN )
+		return Fail(util::fmt("bogus packet capture length %u", caplen));
+
+	if ( len - PCAP_RECORD_HEADER_LEN < caplen )
+		return Result::NeedMore;
+
+	rec->ts.tv_sec = sec;
+	rec->ts.tv_usec = nsec ? frac / 1000 : frac;
+	rec->caplen = caplen;
+	rec->len = wirelen;
+	rec->link_type = link_type;
+	rec->data = buf + PCAP_RECORD_HEADER_LEN;
+
+	*consumed = PCAP_RECORD_HEADER_LEN + caplen;
+	return Result::Packet;
+	}
+
+TraceParser::Result TraceParser::NextPcapNG(const u_char* buf, size_t len, size_t* consumed,
+                                            Record* rec)
+	{
+	size_t off = 0;
+	*consumed = 0;
+
+	while ( true )
+		{
+		const u_char* block = buf + off;
+		size_t avail = len - off;
+
+		if ( avail < 12 )
+			return Result::NeedMore;
+
+		uint32_t type = native32(block);
+
+		if ( type == PCAPNG_SECTION_HEADER_BLOCK )
+			{
+			// A new section may switch byte order and resets all
+			// interfaces.
+			uint32_t bom = native32(block + 8);
+
+			if ( bom == PCAPNG_BYTE_ORDER_MAGIC )
+				swapped = false;
+			else if ( bom == bswap32(PCAPNG_BYTE_ORDER_MAGIC) )
+				swapped = true;
+			else
+				return Fail("bad pcapng byte-order magic");
+			}
+		else
+			type = Get32(block);
+
+		uint32_t total = Get32(block + 4);
+
+		if ( total < 12 || total % 4 != 0 || total > PCAPNG_MAX_BLOCK_LEN )
+			return Fail(util::fmt("bogus pcapng block length %u", total));
+
+		if ( avail < total )
+			return Result::NeedMore;
+
+		const u_char* body = block + 8;
+		size_t body_len = total - 12;
+
+		switch ( type )
+			{
+			case PCAPNG_SECTION_HEADER_BLOCK:
+				interfaces.clear();
+				break;
+
+			case PCAPNG_INTERFACE_DESCRIPTION_BLOCK:
+				if ( ! ParseInterface(body, body_len) )
+					return Result::Error;
+				break;
+
+			case PCAPNG_ENHANCED_PACKET_BLOCK:
+			case PCAPNG_PACKET_BLOCK:
+				{
+				if ( body_len < 20 )
+					return Fail("truncated pcapng packet block");
+
+				uint32_t ifid = type == PCAPNG_ENHANCED_PACKET_BLOCK ? Get32(body) : Get16(body);
+				uint64_t ts = (static_cast<uint64_t>(Get32(body + 4)) << 32) | Get32(body + 8);
+				uint32_t caplen = Get32(body + 12);
+				uint32_t wirelen = Get32(body + 16);
+
+				if ( ifid >= interfaces.size() )
+					return Fail(util::fmt("pcapng packet for unknown interface %u", ifid));
+
+				if ( caplen > body_len - 20 )
+					return Fail(util::fmt("bogus packet capture length %u", caplen));
+
+				const auto& iface = interfaces[ifid];
+				ConvertTimestamp(ts, iface.ts_units, &rec->ts);
+				rec->caplen = caplen;
+				rec->len = wirelen;
+				rec->link_type = iface.link_type;
+				rec->data = body + 20;
+
+				*consumed = off + total;
+				return Result::Packet;
+				}
+
+			case PCAPNG_SIMPLE_PACKET_BLOCK:
+				{
+				if ( body_len < 4 )
+					return Fail("truncated pcapng simple packet block");
+
+				if ( interfaces.empty() )
+					return Fail("pcapng simple packet without interface");
+
+				uint32_t wirelen = Get32(body);
+				uint32_t caplen = std::min(wirelen, static_cast<uint32_t>(body_len - 4));
+
+				// Simple packet blocks don't carry a timestamp.
+				rec->ts.tv_sec = 0;
+				rec->ts.tv_usec = 0;
+				rec->caplen = caplen;
+				rec->len = wirelen;
+				rec->link_type = interfaces[0].link_type;
+				rec->data = body + 4;
+
+				*consumed = off + total;
+				return Result::Packet;
+				}
+
+			default:
+				// Statistics, name resolution, custom blocks, etc.
+				break;
+			}
+
+		off += total;
+		*consumed = off;
+		}
+	}
+
+bool TraceParser::ParseInterface(const u_char* body, size_t len)
+	{
+	if ( len < 8 )
+		{
+		Fail("truncated pcapng interface description block");
+		return false;
+		}
+
+	Interface iface;
+	iface.link_type = linktype_to_dlt(Get16(body));
+	iface.ts_units = 1000000;
+
+	uint32_t if_snaplen = Get32(body + 4);
+
+	size_t off = 8;
+
+	while ( off + 4 <= len )
+		{
+		uint16_t code = Get16(body + off);
+		uint16_t opt_len = Get16(body + off + 2);
+		off += 4;
+
+		if ( code == PCAPNG_OPT_ENDOFOPT || off + opt_len > len )
+			break;
+
+		if ( code == PCAPNG_OPT_IF_TSRESOL && opt_len >= 1 )
+			{
+			uint8_t res = body[off];
+			uint8_t exp = res & 0x7f;
+
+			if ( res & 0x80 )
+				{
+				if ( exp > 63 )
+					{
+					Fail("unsupported pcapng timestamp resolution");
+					return false;
+					}
+
+				iface.ts_units = uint64_t(1) << exp;
+				}
+			else
+				{
+				if ( exp > 19 )
+					{
+					Fail("unsupported pcapng timestamp resolution");
+					return false;
+					}
+
+				iface.ts_units = 1;
+				for ( uint8_t i = 0; i < exp; ++i )
+					iface.ts_units *= 10;
+				}
+			}
+
+		// Options are padded to 32 bits.
+		off += (opt_len + 3) & ~3u;
+		}
+
+	if ( interfaces.empty() && link_type < 0 )
+		{
+		link_type = iface.link_type;
+		snaplen = if_snaplen;
+		}
+
+	interfaces.push_back(iface);
+	return true;
+	}
+
+void TraceParser::ConvertTimestamp(uint64_t ts, uint64_t units, pkt_timeval* tv) const
+	{
+	uint64_t frac = ts % units;
+	tv->tv_sec = static_cast<decltype(tv->tv_sec)>(ts / units);
+
+	if ( units == 1000000 )
+		tv->tv_usec = static_cast<decltype(tv->tv_usec)>(frac);
+	else
+		tv->tv_usec = static_cast<decltype(tv->tv_usec)>(static_cast<double>(frac) * 1e6 /
+		                                                  static_cast<double>(units));
+	}
+
+TEST_CASE("pcap trace parser")
+	{
+	// A little-endian pcap file with one 4-byte packet in nanosecond resolution.
+	const u_char pcap_trace[] = {
+		0x4d, 0x3c, 0xb2, 0xa1, 0x02, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0xff, 0xff, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00,
+		0x40, 0x42, 0x0f, 0x00, 0x04, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0xde, 0xad,
+		0xbe, 0xef,
+	};
+
+	TraceParser parser;
+	TraceParser::Record rec;
+	size_t consumed;
+
+	SUBCASE("complete")
+		{
+		auto res = parser.Next(pcap_trace, sizeof(pcap_trace), &consumed, &rec);
+		CHECK(res == TraceParser::Result::Packet);
+		CHECK(consumed == sizeof(pcap_trace));
+		CHECK(parser.LinkType() == DLT_EN10MB);
+		CHECK(parser.Snaplen() == 65535);
+		CHECK(rec.ts.tv_sec == 10);
+		CHECK(rec.ts.tv_usec == 1000);
+		CHECK(rec.caplen == 4);
+		CHECK(rec.len == 60);
+		CHECK(rec.data == pcap_trace + 40);
+
+		res = parser.Next(pcap_trace + consumed, 0, &consumed, &rec);
+		CHECK(res == TraceParser::Result::NeedMore);
+		}
+
+	SUBCASE("incremental")
+		{
+		auto res = parser.Next(pcap_trace, 30, &consumed, &rec);
+		CHECK(res == TraceParser::Result::NeedMore);
+		CHECK(consumed == 24);
+
+		res = parser.Next(pcap_trace + consumed, sizeof(pcap_trace) - consumed, &consumed, &rec);
+		CHECK(res == TraceParser::Result::Packet);
+		CHECK(rec.caplen == 4);
+		}
+
+	SUBCASE("garbage")
+		{
+		const u_char garbage[] = {'G', 'E', 'T', ' ', '/'};
+		CHECK(parser.Next(garbage, sizeof(garbage), &consumed, &rec) ==
+		      TraceParser::Result::Error);
+		}
+	}
+
+TEST_CASE("pcapng trace parser")
+	{
+	// Little-endian section header, an interface with millisecond
+	// resolution, and one enhanced packet block with 4 bytes of data.
+	const u_char pcapng_trace[] = {
+		// SHB
+		0x0a, 0x0d, 0x0d, 0x0a, 0x1c, 0x00, 0x00, 0x00, 0x4d, 0x3c, 0x2b, 0x1a, 0x01, 0x00,
+		0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x1c, 0x00, 0x00, 0x00,
+		// IDB with if_tsresol = 3
+		0x01, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x01, 0x00, 0x09, 0x00, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x20, 0x00, 0x00, 0x00,
+		// EPB, timestamp 12345 ms
+		0x06, 0x00, 0x00, 0x00, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00, 0x39, 0x30, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+		0xde, 0xad, 0xbe, 0xef, 0x24, 0x00, 0x00, 0x00,
+	};
+
+	TraceParser parser;
+	TraceParser::Record rec;
+	size_t consumed;
+
+	auto res = parser.Next(pcapng_trace, sizeof(pcapng_trace), &consumed, &rec);
+	CHECK(res == TraceParser::Result::Packet);
+	CHECK(consumed == sizeof(pcapng_trace));
+	CHECK(parser.LinkType() == DLT_EN10MB);
+	CHECK(parser.Snaplen() == 65536);
+	CHECK(rec.link_type == DLT_EN10MB);
+	CHECK(rec.ts.tv_sec == 12);
+	CHECK(rec.ts.tv_usec == 345000);
+	CHECK(rec.caplen == 4);
+	CHECK(rec.data == pcapng_trace + 88);
+	}
+
+	} // namespace zeek::iosource::pcap::detail
@@ -0,0 +1,127 @@
+// See the file  in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "zeek/iosource/Packet.h"
+
+namespace zeek::iosource::pcap::detail
+	{
+
+/**
+ * Incremental parser for pcap and pcapng trace files that operates on
+ * in-memory buffers. It does not copy packet data: returned records
+ * point straight into the buffer passed in.
+ *
+ * The parser keeps the state it needs across calls (byte order,
+ * timestamp resolution, pcapng interfaces), so callers can feed it
+ * consecutive chunks of a trace as long as every call starts at the
+ * first byte not yet consumed.
+ */
+class TraceParser
+	{
+public:
+	enum class Result
+		{
+		Packet, ///< A packet record was found.
+		NeedMore, ///< The buffer does not contain a complete record.
+		Error, ///< The trace is malformed, see ErrorMsg().
+		};
+
+	/**
+	 * A single packet record.
+	 */
+	struct Record
+		{
+		pkt_timeval ts;
+		uint32_t caplen = 0;
+		uint32_t len = 0;
+		int link_type = -1;
+		const u_char* data = nullptr;
+		};
+
+	/**
+	 * Parses the next packet from a buffer. Non-packet records, such
+	 * as the file header and pcapng interface or statistics blocks,
+	 * are consumed internally.
+	 *
+	 * @param buf Start of the unconsumed part of the trace.
+	 *
+	 * @param len Number of bytes available at \a buf.
+	 *
+	 * @param consumed Returns the number of bytes consumed from \a buf.
+	 * This can be non-zero even if no packet was found.
+	 *
+	 * @param rec Filled in if a packet was found. Its data points into
+	 * \a buf.
+	 */
+	Result Next(const u_char* buf, size_t len, size_t* consumed, Record* rec);
+
+	/**
+	 * Returns the link type of the trace, or -1 if not yet known. For
+	 * pcapng files, this is the link type of the first interface.
+	 */
+	int LinkType() const { return link_type; }
+
+	/**
+	 * Returns the snapshot length of the trace, or 0 if not yet known.
+	 */
+	uint32_t Snaplen() const { return snaplen; }
+
+	/**
+	 * Returns a description of the last error.
+	 */
+	const std::string& ErrorMsg() const { return error; }
+
+	/**
+	 * Returns true if the buffer starts with a pcap or pcapng magic
+	 * number. At least 4 bytes must be available.
+	 */
+	static bool LooksLikeTrace(const u_char* buf, size_t len);
+
+	/**
+	 * Upper bound on a packet's captured length. Anything larger is
+	 * considered a corrupt trace.
+	 */
+	static constexpr uint32_t MAX_CAPLEN = 16 * 1024 * 1024;
+
+private:
+	enum class Format
+		{
+		Unknown,
+		Pcap,
+		PcapNG,
+		};
+
+	// Per-interface information from pcapng interface description blocks.
+	struct Interface
+		{
+		int link_type;
+		// Timestamp units per second, and whether that's a power of 2.
+		uint64_t ts_units;
+		};
+
+	Result ParseFileHeader(const u_char* buf, size_t len, size_t* consumed);
+	Result NextPcap(const u_char* buf, size_t len, size_t* consumed, Record* rec);
+	Result NextPcapNG(const u_char* buf, size_t len, size_t* consumed, Record* rec);
+	bool ParseInterface(const u_char* body, size_t len);
+	void ConvertTimestamp(uint64_t ts, uint64_t units, pkt_timeval* tv) const;
+	Result Fail(const std::string& msg);
+
+	uint32_t Get32(const u_char* p) const;
+	uint16_t Get16(const u_char* p) const;
+
+	Format format = Format::Unknown;
+	bool swapped = false;
+	bool nsec = false;
+	int link_type = -1;
+	uint32_t snaplen = 0;
+	std::vector<Interface> interfaces;
+	std::string error;
+	};
+
+	} // namespace zeek::iosource::pcap::detail
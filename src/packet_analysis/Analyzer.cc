@@ -68,7 +68,7 @@ bool Analyzer::IsAnalyzer(const char* name)
 	return packet_mgr->GetComponentName(tag) == name;
 	}
 
-AnalyzerPtr Analyzer::Lookup(uint32_t identifier) const
+const AnalyzerPtr& Analyzer::Lookup(uint32_t identifier) const
 	{
 	return dispatcher.Lookup(identifier);
 	}
@@ -76,7 +76,9 @@ AnalyzerPtr Analyzer::Lookup(uint32_t identifier) const
 bool Analyzer::ForwardPacket(size_t len, const uint8_t* data, Packet* packet,
                              uint32_t identifier) const
 	{
-	auto inner_analyzer = Lookup(identifier);
+	// This runs for every protocol layer of every packet, so avoid
+	// touching the analyzers' reference counts.
+	Analyzer* inner_analyzer = Lookup(identifier).get();
 	if ( ! inner_analyzer )
 		{
 		for ( const auto& child : analyzers_to_detect )
@@ -86,14 +88,14 @@ bool Analyzer::ForwardPacket(size_t len, const uint8_t* data, Packet* packet,
 				DBG_LOG(DBG_PACKET_ANALYSIS,
 				        "Protocol detection in %s succeeded, next layer analyzer is %s",
 				        GetAnalyzerName(), child->GetAnalyzerName());
-				inner_analyzer = child;
+				inner_analyzer = child.get();
 				break;
 				}
 			}
 		}
 
 	if ( ! inner_analyzer )
-		inner_analyzer = default_analyzer;
+		inner_analyzer = default_analyzer.get();
 
 	if ( ! inner_analyzer )
 		{
@@ -3,7 +3,10 @@
 #include "zeek/packet_analysis/Dispatcher.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cinttypes>
 
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/DebugLogger.h"
 #include "zeek/Reporter.h"
 #include "zeek/packet_analysis/Analyzer.h"
@@ -11,96 +14,400 @@
 namespace zeek::packet_analysis
 	{
 
+// Identifier spans up to this size always use the direct layout.
+static constexpr uint32_t MAX_SMALL_DIRECT_SPAN = 256;
+
+// Beyond that, the direct layout is used if at least one out of this
+// many slots would be occupied.
+static constexpr uint32_t MAX_DIRECT_SPARSENESS = 4;
+
+// Number of multipliers tried per table size when searching for a
+// collision-free hash.
+static constexpr int MULTIPLIER_ATTEMPTS = 64;
+
+// Number of times the hash table size gets doubled during that search.
+static constexpr int MAX_GROWTH = 2;
+
+static const AnalyzerPtr null_analyzer;
+
 Dispatcher::~Dispatcher()
 	{
-	FreeValues();
+	Clear();
 	}
 
 void Dispatcher::Register(uint32_t identifier, AnalyzerPtr analyzer)
 	{
-	// If the table has size 1 and the entry is nullptr, there was nothing added yet. Just add it.
-	if ( table.size() == 1 && table[0] == nullptr )
+	auto& current = mappings[identifier];
+
+	if ( current != nullptr )
+		reporter->Info("Overwriting packet analyzer mapping %#8" PRIx32 " => %s with %s",
+		               identifier, current->GetAnalyzerName(), analyzer->GetAnalyzerName());
+
+	current = std::move(analyzer);
+	Rebuild();
+	}
+
+const AnalyzerPtr& Dispatcher::LookupSlow(uint32_t identifier) const
+	{
+	Entry* e = FindEntry(identifier);
+
+	if ( ! e )
+		return null_analyzer;
+
+	++e->hits;
+
+	if ( ++misses >= REBALANCE_INTERVAL )
+		Rebalance();
+
+	return *e->analyzer;
+	}
+
+Dispatcher::Entry* Dispatcher::FindEntry(uint32_t identifier) const
+	{
+	switch ( layout )
+		{
+		case Layout::Empty:
+			return nullptr;
+
+		case Layout::Direct:
+			{
+			uint32_t index = identifier - lowest;
+
+			if ( index < entries.size() && entries[index].analyzer )
+				return &entries[index];
+
+			return nullptr;
+			}
+
+		case Layout::Hashed:
+			for ( uint32_t i = HashSlot(identifier);; i = (i + 1) & mask )
+				{
+				Entry& e = entries[i];
+
+				if ( ! e.analyzer )
+					return nullptr;
+
+				if ( e.identifier == identifier )
+					return &e;
+				}
+		}
+
+	return nullptr;
+	}
+
+void Dispatcher::Rebuild()
+	{
+	entries.clear();
+	layout = Layout::Empty;
+	multiplier = shift = mask = 0;
+	misses = 0;
+
+	for ( auto& h : hot )
+		h = {};
+
+	if ( mappings.empty() )
+		return;
+
+	uint32_t count = mappings.size();
+	lowest = mappings.begin()->first;
+	uint64_t span = uint64_t(mappings.rbegin()->first) - lowest + 1;
+
+	if ( span <= MAX_SMALL_DIRECT_SPAN || span <= uint64_t(count) * MAX_DIRECT_SPARSENESS )
 		{
-		table[0] = std::move(analyzer);
-		lowest_identifier = identifier;
+		layout = Layout::Direct;
+		entries.resize(span);
+
+		for ( const auto& [identifier, analyzer] : mappings )
+			{
+			if ( ! analyzer )
+				continue;
+
+			Entry& e = entries[identifier - lowest];
+			e.identifier = identifier;
+			e.analyzer = &analyzer;
+			}
+
 		return;
 		}
 
-	// If highestIdentifier == identifier, overwrite would happen -> no check needed, will return
-	// false
-	if ( GetHighestIdentifier() < identifier )
+	layout = Layout::Hashed;
+
+	// Keep the load factor at or below one half.
+	uint32_t size = 8;
+	while ( size < 2 * count )
+		size <<= 1;
+
+	// Search for a multiplier under which all identifiers land in
+	// distinct slots, so that lookups never probe. The candidates are
+	// derived from the golden ratio; they must be odd.
+	for ( int growth = 0; growth <= MAX_GROWTH; ++growth, size <<= 1 )
 		{
-		table.resize(table.size() + (identifier - GetHighestIdentifier()), nullptr);
+		uint32_t candidate = 0x9E3779B1;
+
+		for ( int i = 0; i < MULTIPLIER_ATTEMPTS; ++i )
+			{
+			if ( BuildHashed(size, candidate, false) )
+				return;
+
+			candidate = (candidate * 0x2C1B3C6D + 0x297A2D39) | 1;
+			}
 		}
-	else if ( identifier < lowest_identifier )
+
+	// No luck, fall back to linear probing at the default size.
+	size = 8;
+	while ( size < 2 * count )
+		size <<= 1;
+
+	BuildHashed(size, 0x9E3779B1, true);
+	}
+
+bool Dispatcher::BuildHashed(uint32_t size, uint32_t arg_multiplier, bool allow_collisions)
+	{
+	int bits = 0;
+	while ( (1u << bits) < size )
+		++bits;
+
+	multiplier = arg_multiplier;
+	shift = 32 - bits;
+	mask = size - 1;
+
+	entries.assign(size, Entry{});
+
+	for ( const auto& [identifier, analyzer] : mappings )
 		{
-		// Lower than the lowest registered identifier. Shift up by lowerBound - identifier
-		uint32_t distance = lowest_identifier - identifier;
-		table.resize(table.size() + distance, nullptr);
+		if ( ! analyzer )
+			continue;
 
-		// Shift values
-		for ( ssize_t i = table.size() - 1; i >= 0; i-- )
+		uint32_t i = HashSlot(identifier);
+
+		if ( entries[i].analyzer )
 			{
-			if ( table[i] != nullptr )
-				{
-				table.at(i + distance) = std::move(table.at(i));
-				table.at(i) = nullptr;
-				}
+			if ( ! allow_collisions )
+				return false;
+
+			while ( entries[i].analyzer )
+				i = (i + 1) & mask;
 			}
 
-		lowest_identifier = identifier;
+		entries[i].identifier = identifier;
+		entries[i].analyzer = &analyzer;
 		}
 
-	int64_t index = identifier - lowest_identifier;
-	if ( table[index] != nullptr )
-		reporter->Info("Overwriting packet analyzer mapping %#8" PRIx64 " => %s with %s",
-		               index + lowest_identifier, table[index]->GetAnalyzerName(),
-		               analyzer->GetAnalyzerName());
-	table[index] = std::move(analyzer);
+	return true;
 	}
 
-AnalyzerPtr Dispatcher::Lookup(uint32_t identifier) const
+void Dispatcher::Rebalance() const
 	{
-	int64_t index = identifier - lowest_identifier;
-	if ( index >= 0 && index < static_cast<int64_t>(table.size()) && table[index] != nullptr )
-		return table[index];
+	misses = 0;
 
-	return nullptr;
+	// Fold the hot entries' counts back into the table.
+	for ( auto& h : hot )
+		{
+		if ( h.analyzer )
+			FindEntry(h.identifier)->hits += h.hits;
+
+		h = {};
+		}
+
+	Entry* top[HOT_ENTRIES] = {};
+
+	for ( auto& e : entries )
+		{
+		if ( ! e.analyzer || e.hits == 0 )
+			continue;
+
+		for ( size_t i = 0; i < HOT_ENTRIES; ++i )
+			{
+			if ( ! top[i] || e.hits > top[i]->hits )
+				{
+				std::copy_backward(top + i, top + HOT_ENTRIES - 1, top + HOT_ENTRIES);
+				top[i] = &e;
+				break;
+				}
+			}
+		}
+
+	for ( size_t i = 0; i < HOT_ENTRIES; ++i )
+		if ( top[i] )
+			hot[i] = {top[i]->identifier, 0, top[i]->analyzer};
+
+	// Age the counts so that the hot set follows changes in the traffic.
+	for ( auto& e : entries )
+		e.hits /= 2;
 	}
 
 size_t Dispatcher::Count() const
 	{
-	return std::count_if(table.begin(), table.end(),
-	                     [](AnalyzerPtr a)
+	return std::count_if(mappings.begin(), mappings.end(),
+	                     [](const auto& m)
 	                     {
-							 return a != nullptr;
+							 return m.second != nullptr;
 						 });
 	}
 
 void Dispatcher::Clear()
 	{
-	FreeValues();
-	table.clear();
-	}
-
-void Dispatcher::FreeValues()
-	{
-	for ( auto& current : table )
-		current = nullptr;
+	mappings.clear();
+	Rebuild();
 	}
 
 void Dispatcher::DumpDebug() const
 	{
 #ifdef DEBUG
-	DBG_LOG(DBG_PACKET_ANALYSIS, "Dispatcher elements (used/total): %lu/%lu", Count(),
-	        table.size());
-	for ( size_t i = 0; i < table.size(); i++ )
+	DBG_LOG(DBG_PACKET_ANALYSIS, "Dispatcher elements (used/slots): %lu/%lu (%s)", Count(),
+	        entries.size(), layout == Layout::Hashed ? "hashed" : "direct");
+	for ( const auto& [identifier, analyzer] : mappings )
 		{
-		if ( table[i] != nullptr )
-			DBG_LOG(DBG_PACKET_ANALYSIS, "%#8lx => %s", i + lowest_identifier,
-			        table[i]->GetAnalyzerName());
+		if ( analyzer != nullptr )
+			DBG_LOG(DBG_PACKET_ANALYSIS, "%#8" PRIx32 " => %s", identifier,
+			        analyzer->GetAnalyzerName());
 		}
 #endif
 	}
 
 	}
+
+namespace
+	{
+
+// The dispatcher only stores and hands back pointers, it never calls into
+// the analyzers. Point the tests' AnalyzerPtrs at plain integers rather
+// than setting up real analyzers.
+std::vector<zeek::packet_analysis::AnalyzerPtr> make_test_analyzers(std::vector<int>& storage)
+	{
+	std::vector<zeek::packet_analysis::AnalyzerPtr> result;
+	auto owner = std::make_shared<int>(0);
+
+	for ( auto& i : storage )
+		result.emplace_back(owner, reinterpret_cast<zeek::packet_analysis::Analyzer*>(&i));
+
+	return result;
+	}
+
+// EtherTypes registered by the default scripts, as a realistic sparse set.
+const std::vector<uint32_t> test_ethertypes = {0x0800, 0x0806, 0x8035, 0x86DD, 0x8100,
+                                               0x8847, 0x8864, 0x88A8, 0x88E5, 0x9100};
+
+	}
+
+TEST_CASE("packet analysis dispatcher")
+	{
+	using zeek::packet_analysis::Dispatcher;
+
+	std::vector<int> storage(test_ethertypes.size());
+	auto analyzers = make_test_analyzers(storage);
+
+	SUBCASE("empty")
+		{
+		Dispatcher d;
+		CHECK(d.Count() == 0);
+		CHECK(d.Lookup(0) == nullptr);
+		CHECK(d.Lookup(0x0800) == nullptr);
+		}
+
+	SUBCASE("dense")
+		{
+		Dispatcher d;
+		d.Register(17, analyzers[0]);
+		d.Register(6, analyzers[1]);
+		d.Register(1, analyzers[2]);
+
+		CHECK(d.Count() == 3);
+		CHECK(d.Lookup(1) == analyzers[2]);
+		CHECK(d.Lookup(6) == analyzers[1]);
+		CHECK(d.Lookup(17) == analyzers[0]);
+		CHECK(d.Lookup(0) == nullptr);
+		CHECK(d.Lookup(2) == nullptr);
+		CHECK(d.Lookup(18) == nullptr);
+		CHECK(d.Lookup(0xFFFFFFFF) == nullptr);
+		}
+
+	SUBCASE("sparse")
+		{
+		Dispatcher d;
+
+		for ( size_t i = 0; i < test_ethertypes.size(); ++i )
+			d.Register(test_ethertypes[i], analyzers[i]);
+
+		CHECK(d.Count() == test_ethertypes.size());
+
+		// Enough lookups to exercise the hot entries' rebalancing.
+		for ( int round = 0; round < 10000; ++round )
+			for ( size_t i = 0; i < test_ethertypes.size(); ++i )
+				REQUIRE(d.Lookup(test_ethertypes[i]) == analyzers[i]);
+
+		CHECK(d.Lookup(0) == nullptr);
+		CHECK(d.Lookup(0x0801) == nullptr);
+		CHECK(d.Lookup(0x88CC) == nullptr);
+		CHECK(d.Lookup(0xFFFFFFFF) == nullptr);
+
+		d.Clear();
+		CHECK(d.Count() == 0);
+		CHECK(d.Lookup(0x0800) == nullptr);
+		}
+	}
+
+TEST_CASE("packet analysis dispatcher benchmark" * doctest::skip())
+	{
+	// Run with: zeek --test --no-skip -tc="packet analysis dispatcher benchmark"
+	using zeek::packet_analysis::AnalyzerPtr;
+	using zeek::packet_analysis::Dispatcher;
+	using clock = std::chrono::steady_clock;
+
+	std::vector<int> storage(test_ethertypes.size());
+	auto analyzers = make_test_analyzers(storage);
+
+	Dispatcher d;
+
+	// The previous implementation: a vector spanning lowest to highest
+	// identifier, returning AnalyzerPtr by value.
+	uint32_t lowest = test_ethertypes.front();
+	std::vector<AnalyzerPtr> table(test_ethertypes.back() - lowest + 1);
+
+	for ( size_t i = 0; i < test_ethertypes.size(); ++i )
+		{
+		d.Register(test_ethertypes[i], analyzers[i]);
+		table[test_ethertypes[i] - lowest] = analyzers[i];
+		}
+
+	auto old_lookup = [&](uint32_t identifier) -> AnalyzerPtr
+	{
+		int64_t index = identifier - lowest;
+		if ( index >= 0 && index < static_cast<int64_t>(table.size()) && table[index] != nullptr )
+			return table[index];
+
+		return nullptr;
+	};
+
+	// Traffic mix dominated by IPv4 and IPv6, with a tail of others.
+	std::vector<uint32_t> stream;
+	for ( int i = 0; i < 1000; ++i )
+		stream.push_back(i % 10 < 6   ? 0x0800
+		                 : i % 10 < 9 ? 0x86DD
+		                              : test_ethertypes[i % test_ethertypes.size()]);
+
+	constexpr int rounds = 20000;
+	uintptr_t sink = 0;
+
+	auto start = clock::now();
+	for ( int r = 0; r < rounds; ++r )
+		for ( auto id : stream )
+			sink += reinterpret_cast<uintptr_t>(old_lookup(id).get());
+	auto old_time = clock::now() - start;
+
+	start = clock::now();
+	for ( int r = 0; r < rounds; ++r )
+		for ( auto id : stream )
+			sink += reinterpret_cast<uintptr_t>(d.Lookup(id).get());
+	auto new_time = clock::now() - start;
+
+	auto ns_per_lookup = [&](auto t)
+	{
+		return std::chrono::duration<double, std::nano>(t).count() / (rounds * stream.size());
+	};
+
+	MESSAGE("vector table: " << ns_per_lookup(old_time) << " ns/lookup, " << table.size()
+	                         << " slots");
+	MESSAGE("dispatcher:   " << ns_per_lookup(new_time) << " ns/lookup");
+	CHECK(sink != 0);
+	}
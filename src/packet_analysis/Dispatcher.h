@@ -15,11 +15,18 @@ using AnalyzerPtr = std::shared_ptr<zeek::packet_analysis::Analyzer>;
 
 /**
  * The Dispatcher class manages identifier-to-analyzer mappings.
+ *
+ * Mappings are kept in an ordered map. Every time they change, the
+ * dispatcher rebuilds a compact lookup structure from them: a directly
+ * indexed array if the identifiers are dense, or an open-addressing hash
+ * table with a multiplier chosen to avoid collisions if they are sparse
+ * (e.g., EtherTypes or ports). In front of that, the few most frequently
+ * looked up identifiers are checked first.
  */
 class Dispatcher
 	{
 public:
-	Dispatcher() : table(std::vector<AnalyzerPtr>(1, nullptr)){};
+	Dispatcher() = default;
 	~Dispatcher();
 
 	/**
@@ -37,7 +44,17 @@ public:
 	 * @return The analyzer registered for the given identifier. Returns a
 	 * nullptr if no analyzer is registered.
 	 */
-	AnalyzerPtr Lookup(uint32_t identifier) const;
+	const AnalyzerPtr& Lookup(uint32_t identifier) const
+		{
+		for ( auto& h : hot )
+			if ( h.analyzer && h.identifier == identifier )
+				{
+				++h.hits;
+				return *h.analyzer;
+				}
+
+		return LookupSlow(identifier);
+		}
 
 	/**
 	 * Returns the number of registered analyzers.
@@ -56,12 +73,57 @@ public:
 	void DumpDebug() const;
 
 private:
-	uint32_t lowest_identifier = 0;
-	std::vector<AnalyzerPtr> table;
+	// A slot of the lookup structures. Empty slots have a null analyzer.
+	struct Entry
+		{
+		uint32_t identifier = 0;
+		uint32_t hits = 0;
+		const AnalyzerPtr* analyzer = nullptr;
+		};
+
+	enum class Layout
+		{
+		Empty,
+		Direct,
+		Hashed
+		};
+
+	// Number of identifiers checked before the main lookup structure.
+	static constexpr size_t HOT_ENTRIES = 2;
+
+	// Number of lookups that miss the hot entries after which we
+	// re-evaluate which identifiers should be hot.
+	static constexpr uint32_t REBALANCE_INTERVAL = 1 << 14;
+
+	const AnalyzerPtr& LookupSlow(uint32_t identifier) const;
+	Entry* FindEntry(uint32_t identifier) const;
+	void Rebuild();
+	bool BuildHashed(uint32_t size, uint32_t multiplier, bool allow_collisions);
+	void Rebalance() const;
+
+	uint32_t HashSlot(uint32_t identifier) const
+		{
+		return (identifier * multiplier) >> shift;
+		}
+
+	// The authoritative mappings. Node-based, so the lookup structures
+	// can point to the values.
+	std::map<uint32_t, AnalyzerPtr> mappings;
+
+	Layout layout = Layout::Empty;
 
-	void FreeValues();
+	// For Layout::Direct, the entry for identifier i is at i - lowest.
+	// For Layout::Hashed, entries are placed by HashSlot(), which usually
+	// is collision-free; if no such multiplier could be found, collisions
+	// are resolved by linear probing.
+	mutable std::vector<Entry> entries;
+	uint32_t lowest = 0;
+	uint32_t multiplier = 0;
+	uint32_t shift = 0;
+	uint32_t mask = 0;
 
-	inline uint32_t GetHighestIdentifier() const { return lowest_identifier + table.size() - 1; }
+	mutable Entry hot[HOT_ENTRIES];
+	mutable uint32_t misses = 0;
 	};
 
 	}
@@ -8,7 +8,9 @@
 #include "zeek/iosource/PktDumper.h"
 #include "zeek/packet_analysis/Analyzer.h"
 #include "zeek/packet_analysis/Dispatcher.h"
+#include "zeek/packet_analysis/OuterFlow.h"
 #include "zeek/plugin/Manager.h"
+#include "zeek/session/Manager.h"
 #include "zeek/zeek-bif.h"
 
 using namespace zeek::packet_analysis;
@@ -127,6 +129,13 @@ void Manager::ProcessPacket(Packet* packet)
 		dumped_packet = true;
 		}
 
+	// Packets of shunted flows only get counted.
+	if ( shunt_table.Match(packet) )
+		{
+		packet->processed = true;
+		return;
+		}
+
 	// Start packet analysis
 	root_analyzer->ForwardPacket(packet->cap_len, packet->data, packet, packet->link_type);
 
@@ -151,6 +160,21 @@ void Manager::ProcessPacket(Packet* packet)
 		DumpPacket(packet, packet->dump_size);
 	}
 
+void Manager::PrefetchSession(const Packet* packet)
+	{
+	OuterFlow flow;
+
+	if ( ! parse_outer_flow(packet, &flow) )
+		return;
+
+	IPAddr src(IPv6, flow.src_h, IPAddr::Network);
+	IPAddr dst(IPv6, flow.dst_h, IPAddr::Network);
+	TransportProto proto = flow.proto == IPPROTO_TCP ? TRANSPORT_TCP : TRANSPORT_UDP;
+
+	zeek::detail::ConnKey key(src, dst, htons(flow.src_p), htons(flow.dst_p), proto, false);
+	session_mgr->PrefetchConnection(key);
+	}
+
 bool Manager::ProcessInnerPacket(Packet* packet)
 	{
 	return root_analyzer->ForwardPacket(packet->cap_len, packet->data, packet, packet->link_type);
@@ -8,6 +8,7 @@
 #include "zeek/iosource/Packet.h"
 #include "zeek/packet_analysis/Component.h"
 #include "zeek/packet_analysis/Dispatcher.h"
+#include "zeek/packet_analysis/ShuntTable.h"
 #include "zeek/plugin/ComponentManager.h"
 
 namespace zeek
@@ -129,6 +130,15 @@ public:
 	 */
 	void ProcessPacket(Packet* packet);
 
+	/**
+	 * Prefetches the session table entry for a packet that's about to be
+	 * processed. Packet sources delivering batches call this for the next
+	 * packet while the current one is being analyzed.
+	 *
+	 * @param packet The upcoming packet.
+	 */
+	void PrefetchSession(const Packet* packet);
+
 	/**
 	 * Process the inner packet of an encapsulation. This can be used by tunnel
 	 * analyzers to process a inner packet from the "beginning" directly through
@@ -182,6 +192,12 @@ public:
 	 */
 	uint64_t GetUnprocessedCount() const { return total_not_processed; }
 
+	/**
+	 * Returns the table of flows whose packets get dropped before analysis.
+	 */
+	ShuntTable& GetShuntTable() { return shunt_table; }
+	const ShuntTable& GetShuntTable() const { return shunt_table; }
+
 private:
 	/**
 	 * Instantiates a new analyzer instance.
@@ -222,6 +238,8 @@ private:
 
 	uint64_t total_not_processed = 0;
 	iosource::PktDumper* unprocessed_dumper = nullptr;
+
+	ShuntTable shunt_table;
 	};
 
 	} // namespace packet_analysis
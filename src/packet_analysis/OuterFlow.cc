@@ -0,0 +1,143 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/packet_analysis/OuterFlow.h"
+
+#include <netinet/in.h>
+#include <pcap.h> // For DLT_ constants
+#include <cstring>
+
+#include "zeek/iosource/Packet.h"
+
+namespace zeek::packet_analysis
+	{
+
+static constexpr uint16_t ETHERTYPE_IPV4 = 0x0800;
+static constexpr uint16_t ETHERTYPE_IPV6 = 0x86DD;
+
+static inline uint16_t read_u16(const u_char* p)
+	{
+	return (uint16_t(p[0]) << 8) | p[1];
+	}
+
+bool parse_outer_flow(const Packet* pkt, OuterFlow* flow)
+	{
+	const u_char* data = pkt->data;
+	uint32_t len = pkt->cap_len;
+	uint16_t ethertype;
+
+	// Find the outermost IP header.
+	switch ( pkt->link_type )
+		{
+		case DLT_EN10MB:
+			{
+			uint32_t off = 12;
+
+			if ( len < off + 2 )
+				return false;
+
+			ethertype = read_u16(data + off);
+
+			// 802.1Q, 802.1ad and the legacy QinQ EtherType.
+			while ( ethertype == 0x8100 || ethertype == 0x88A8 || ethertype == 0x9100 )
+				{
+				off += 4;
+
+				if ( len < off + 2 )
+					return false;
+
+				ethertype = read_u16(data + off);
+				}
+
+			data += off + 2;
+			len -= off + 2;
+			break;
+			}
+
+		case 113: // DLT_LINUX_SLL
+			if ( len < 16 )
+				return false;
+
+			ethertype = read_u16(data + 14);
+			data += 16;
+			len -= 16;
+			break;
+
+		case DLT_RAW:
+#ifdef DLT_IPV4
+		case DLT_IPV4:
+#endif
+#ifdef DLT_IPV6
+		case DLT_IPV6:
+#endif
+			if ( len < 1 )
+				return false;
+
+			ethertype = (data[0] >> 4) == 6 ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+			break;
+
+		default:
+			// Other link types may still carry IP, but that's up to
+			// their packet analyzers to figure out.
+			return false;
+		}
+
+	uint32_t* src = flow->src_h;
+	uint32_t* dst = flow->dst_h;
+	uint8_t proto;
+	uint32_t ip_len;
+	uint32_t hdr_len;
+
+	if ( ethertype == ETHERTYPE_IPV4 )
+		{
+		if ( len < 20 || (data[0] >> 4) != 4 )
+			return false;
+
+		hdr_len = (data[0] & 0x0f) * 4;
+
+		if ( hdr_len < 20 )
+			return false;
+
+		ip_len = read_u16(data + 2);
+
+		// No fragments: non-first ones don't carry ports.
+		if ( read_u16(data + 6) & 0x3fff )
+			return false;
+
+		proto = data[9];
+
+		src[0] = src[1] = dst[0] = dst[1] = 0;
+		src[2] = dst[2] = htonl(0xffff);
+		memcpy(&src[3], data + 12, 4);
+		memcpy(&dst[3], data + 16, 4);
+		}
+
+	else if ( ethertype == ETHERTYPE_IPV6 )
+		{
+		if ( len < 40 || (data[0] >> 4) != 6 )
+			return false;
+
+		hdr_len = 40;
+		ip_len = read_u16(data + 4) + 40;
+		proto = data[6];
+
+		memcpy(src, data + 8, 16);
+		memcpy(dst, data + 24, 16);
+		}
+
+	else
+		return false;
+
+	if ( proto != IPPROTO_TCP && proto != IPPROTO_UDP )
+		return false;
+
+	if ( len < hdr_len + 4 )
+		return false;
+
+	flow->src_p = read_u16(data + hdr_len);
+	flow->dst_p = read_u16(data + hdr_len + 2);
+	flow->proto = proto;
+	flow->ip_len = ip_len;
+	return true;
+	}
+
+	} // namespace zeek::packet_analysis
@@ -0,0 +1,52 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+
+namespace zeek
+	{
+
+class Packet;
+
+namespace packet_analysis
+	{
+
+/**
+ * The TCP or UDP flow of a packet's outermost IP header, as extracted by
+ * parse_outer_flow().
+ */
+struct OuterFlow
+	{
+	// Addresses in network byte order, IPv4 ones mapped into IPv6 the
+	// same way IPAddr does.
+	uint32_t src_h[4];
+	uint32_t dst_h[4];
+
+	// Ports in host byte order.
+	uint16_t src_p;
+	uint16_t dst_p;
+
+	// IPPROTO_TCP or IPPROTO_UDP.
+	uint8_t proto;
+
+	// Length of the IP packet, as given by its header.
+	uint32_t ip_len;
+	};
+
+/**
+ * Extracts the transport-layer flow from a raw packet ahead of the regular
+ * analysis, without any of its state. This understands Ethernet (including
+ * VLAN tags), Linux cooked and raw IP links. Fragments and IPv6 packets with
+ * extension headers aren't parsed.
+ *
+ * @param pkt The packet, which only needs to have its link type and data
+ * set.
+ * @param flow Receives the flow.
+ * @return True if the packet is a TCP or UDP packet in a supported
+ * encapsulation.
+ */
+bool parse_outer_flow(const Packet* pkt, OuterFlow* flow);
+
+	} // namespace packet_analysis
+	} // namespace zeek
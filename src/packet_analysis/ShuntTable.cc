@@ -0,0 +1,201 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/packet_analysis/ShuntTable.h"
+
+#include <netinet/in.h>
+#include <pcap.h> // For DLT_ constants
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/Hash.h"
+#include "zeek/iosource/Packet.h"
+#include "zeek/packet_analysis/OuterFlow.h"
+
+namespace zeek::packet_analysis
+	{
+
+size_t ShuntTable::KeyHash::operator()(const Key& k) const
+	{
+	return zeek::detail::KeyedHash::Hash64(&k, sizeof(k));
+	}
+
+bool ShuntTable::MakeKey(const uint32_t* src_h, uint16_t src_p, const uint32_t* dst_h,
+                         uint16_t dst_p, uint8_t proto, Key* key)
+	{
+	int cmp = memcmp(src_h, dst_h, 4 * sizeof(uint32_t));
+	bool src_first = cmp < 0 || (cmp == 0 && src_p <= dst_p);
+
+	memset(key, 0, sizeof(*key));
+
+	if ( src_first )
+		{
+		memcpy(key->addr1, src_h, sizeof(key->addr1));
+		memcpy(key->addr2, dst_h, sizeof(key->addr2));
+		key->port1 = src_p;
+		key->port2 = dst_p;
+		}
+	else
+		{
+		memcpy(key->addr1, dst_h, sizeof(key->addr1));
+		memcpy(key->addr2, src_h, sizeof(key->addr2));
+		key->port1 = dst_p;
+		key->port2 = src_p;
+		}
+
+	key->proto = proto;
+	return src_first;
+	}
+
+bool ShuntTable::MakeKey(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h,
+                         uint16_t resp_p, TransportProto proto, Key* key, bool* orig_first)
+	{
+	uint8_t ip_proto;
+
+	if ( proto == TRANSPORT_TCP )
+		ip_proto = IPPROTO_TCP;
+	else if ( proto == TRANSPORT_UDP )
+		ip_proto = IPPROTO_UDP;
+	else
+		return false;
+
+	uint32_t o[4];
+	uint32_t r[4];
+	orig_h.CopyIPv6(o);
+	resp_h.CopyIPv6(r);
+
+	*orig_first = MakeKey(o, orig_p, r, resp_p, ip_proto, key);
+	return true;
+	}
+
+bool ShuntTable::Add(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h,
+                     uint16_t resp_p, TransportProto proto)
+	{
+	Key key;
+	bool orig_first;
+
+	if ( ! MakeKey(orig_h, orig_p, resp_h, resp_p, proto, &key, &orig_first) )
+		return false;
+
+	return flows.emplace(key, Flow{orig_first, {}}).second;
+	}
+
+bool ShuntTable::Remove(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h,
+                        uint16_t resp_p, TransportProto proto, Stats* stats)
+	{
+	Key key;
+	bool orig_first;
+
+	if ( flows.empty() || ! MakeKey(orig_h, orig_p, resp_h, resp_p, proto, &key, &orig_first) )
+		return false;
+
+	auto it = flows.find(key);
+
+	if ( it == flows.end() )
+		return false;
+
+	if ( stats )
+		*stats = it->second.stats;
+
+	flows.erase(it);
+	return true;
+	}
+
+bool ShuntTable::Lookup(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h,
+                        uint16_t resp_p, TransportProto proto, Stats* stats) const
+	{
+	Key key;
+	bool orig_first;
+
+	if ( flows.empty() || ! MakeKey(orig_h, orig_p, resp_h, resp_p, proto, &key, &orig_first) )
+		return false;
+
+	auto it = flows.find(key);
+
+	if ( it == flows.end() )
+		return false;
+
+	if ( stats )
+		*stats = it->second.stats;
+
+	return true;
+	}
+
+bool ShuntTable::MatchSlow(const Packet* pkt)
+	{
+	OuterFlow flow;
+
+	if ( ! parse_outer_flow(pkt, &flow) )
+		return false;
+
+	Key key;
+	bool src_first = MakeKey(flow.src_h, flow.src_p, flow.dst_h, flow.dst_p, flow.proto, &key);
+
+	auto it = flows.find(key);
+
+	if ( it == flows.end() )
+		return false;
+
+	auto& f = it->second;
+
+	if ( src_first == f.orig_first )
+		{
+		++f.stats.orig_pkts;
+		f.stats.orig_ip_bytes += flow.ip_len;
+		}
+	else
+		{
+		++f.stats.resp_pkts;
+		f.stats.resp_ip_bytes += flow.ip_len;
+		}
+
+	if ( f.stats.first_seen == 0.0 )
+		f.stats.first_seen = pkt->time;
+
+	f.stats.last_seen = pkt->time;
+	++packets_shunted;
+	return true;
+	}
+
+	} // namespace zeek::packet_analysis
+
+TEST_CASE("shunt table")
+	{
+	using zeek::packet_analysis::ShuntTable;
+
+	// Ethernet, VLAN 10, IPv4 10.0.0.1:1234 -> 10.0.0.2:80 TCP, 40 bytes.
+	u_char frame[] = {
+		0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0x81, 0x00,
+		0x00, 0x0a, 0x08, 0x00, 0x45, 0x00, 0x00, 0x28, 0x00, 0x00, 0x40, 0x00, 0x40, 0x06,
+		0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00, 0x00, 0x02, 0x04, 0xd2, 0x00, 0x50,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x10, 0x00, 0x00, 0x00, 0x00,
+		0x00, 0x00};
+
+	pkt_timeval ts = {1, 0};
+	zeek::Packet pkt(DLT_EN10MB, &ts, sizeof(frame), sizeof(frame), frame);
+
+	ShuntTable t;
+	zeek::IPAddr a("10.0.0.1");
+	zeek::IPAddr b("10.0.0.2");
+
+	CHECK_FALSE(t.Match(&pkt));
+
+	// The flow as seen from the other side.
+	CHECK(t.Add(b, 80, a, 1234, TRANSPORT_TCP));
+	CHECK_FALSE(t.Add(a, 1234, b, 80, TRANSPORT_TCP));
+	CHECK_FALSE(t.Add(a, 1, b, 2, TRANSPORT_ICMP));
+	CHECK(t.Size() == 1);
+
+	CHECK(t.Match(&pkt));
+	CHECK(t.Match(&pkt));
+
+	ShuntTable::Stats s;
+	CHECK_FALSE(t.Lookup(a, 1234, b, 80, TRANSPORT_UDP, &s));
+	CHECK(t.Remove(b, 80, a, 1234, TRANSPORT_TCP, &s));
+	CHECK(s.orig_pkts == 0);
+	CHECK(s.resp_pkts == 2);
+	CHECK(s.resp_ip_bytes == 80);
+	CHECK(s.last_seen == 1.0);
+	CHECK(t.PacketsShunted() == 2);
+
+	CHECK_FALSE(t.Match(&pkt));
+	CHECK(t.Size() == 0);
+	}
@@ -0,0 +1,143 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#include "zeek/IPAddr.h"
+#include "zeek/net_util.h"
+
+namespace zeek
+	{
+
+class Packet;
+
+namespace packet_analysis
+	{
+
+/**
+ * A table of flows that scripts have asked to bypass analysis for. The
+ * packet analysis manager consults it before handing a packet to the root
+ * analyzer; packets of shunted flows are only counted and then dropped,
+ * skipping session lookup, reassembly and protocol analysis.
+ *
+ * Matching works on the outermost IPv4/IPv6 header for TCP and UDP packets
+ * on Ethernet (including VLAN tags), Linux cooked and raw IP links.
+ * Fragments and IPv6 packets with extension headers are never matched.
+ */
+class ShuntTable
+	{
+public:
+	/**
+	 * Counters collected for a shunted flow.
+	 */
+	struct Stats
+		{
+		uint64_t orig_pkts = 0;
+		uint64_t orig_ip_bytes = 0;
+		uint64_t resp_pkts = 0;
+		uint64_t resp_ip_bytes = 0;
+		double first_seen = 0.0;
+		double last_seen = 0.0;
+		};
+
+	/**
+	 * Starts shunting a flow.
+	 *
+	 * @return False if the flow's transport protocol isn't supported, or
+	 * if the flow was already shunted.
+	 */
+	bool Add(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h, uint16_t resp_p,
+	         TransportProto proto);
+
+	/**
+	 * Stops shunting a flow.
+	 *
+	 * @param stats If non-null and the flow was shunted, receives its
+	 * counters.
+	 *
+	 * @return True if the flow was shunted.
+	 */
+	bool Remove(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h, uint16_t resp_p,
+	            TransportProto proto, Stats* stats = nullptr);
+
+	/**
+	 * Returns the counters of a shunted flow.
+	 *
+	 * @return True if the flow is shunted.
+	 */
+	bool Lookup(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h, uint16_t resp_p,
+	            TransportProto proto, Stats* stats) const;
+
+	/**
+	 * Checks whether a packet belongs to a shunted flow, and if so counts
+	 * it.
+	 *
+	 * @return True if the packet should be dropped.
+	 */
+	bool Match(const Packet* pkt)
+		{
+		return ! flows.empty() && MatchSlow(pkt);
+		}
+
+	/**
+	 * Returns the number of shunted flows.
+	 */
+	size_t Size() const { return flows.size(); }
+
+	/**
+	 * Returns the total number of packets dropped because of shunting.
+	 */
+	uint64_t PacketsShunted() const { return packets_shunted; }
+
+	/**
+	 * Removes all flows.
+	 */
+	void Clear() { flows.clear(); }
+
+private:
+	// The endpoints of a flow, in a canonical order so that both
+	// directions map to the same key.
+	struct Key
+		{
+		uint32_t addr1[4];
+		uint32_t addr2[4];
+		uint16_t port1;
+		uint16_t port2;
+		uint8_t proto;
+		uint8_t pad[3];
+
+		bool operator==(const Key& other) const { return memcmp(this, &other, sizeof(*this)) == 0; }
+		};
+
+	struct KeyHash
+		{
+		size_t operator()(const Key& k) const;
+		};
+
+	struct Flow
+		{
+		// True if the originator is the first endpoint of the key.
+		bool orig_first;
+		Stats stats;
+		};
+
+	// Builds the key for a flow; addresses are in network byte order,
+	// ports in host byte order. Returns whether the source endpoint ended
+	// up first.
+	static bool MakeKey(const uint32_t* src_h, uint16_t src_p, const uint32_t* dst_h,
+	                    uint16_t dst_p, uint8_t proto, Key* key);
+
+	static bool MakeKey(const IPAddr& orig_h, uint16_t orig_p, const IPAddr& resp_h,
+	                    uint16_t resp_p, TransportProto proto, Key* key, bool* orig_first);
+
+	bool MatchSlow(const Packet* pkt);
+
+	std::unordered_map<Key, Flow, KeyHash> flows;
+	uint64_t packets_shunted = 0;
+	};
+
+	} // namespace packet_analysis
+	} // namespace zeek
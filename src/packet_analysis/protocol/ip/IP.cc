@@ -33,6 +33,30 @@ IPAnalyzer::~IPAnalyzer()
 	delete discarder;
 	}
 
+std::shared_ptr<IP_Hdr> IPAnalyzer::NewIPHdr(const struct ip* ip4)
+	{
+	if ( spare_hdr && spare_hdr.use_count() == 1 )
+		{
+		spare_hdr->Reset(ip4);
+		return spare_hdr;
+		}
+
+	spare_hdr = std::make_shared<IP_Hdr>(ip4, false);
+	return spare_hdr;
+	}
+
+std::shared_ptr<IP_Hdr> IPAnalyzer::NewIPHdr(const struct ip6_hdr* ip6, size_t len)
+	{
+	if ( spare_hdr && spare_hdr.use_count() == 1 )
+		{
+		spare_hdr->Reset(ip6, len);
+		return spare_hdr;
+		}
+
+	spare_hdr = std::make_shared<IP_Hdr>(ip6, false, len);
+	return spare_hdr;
+	}
+
 bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 	{
 	// Check to make sure we have enough data left for an IP header to be here. Note we only
@@ -53,7 +77,7 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 
 	if ( protocol == 4 )
 		{
-		ip_hdr = std::make_shared<IP_Hdr>(ip, false);
+		ip_hdr = NewIPHdr(ip);
 		packet->l3_proto = L3_IPV4;
 		}
 	else if ( protocol == 6 )
@@ -64,8 +88,7 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			return false;
 			}
 
-		ip_hdr = std::make_shared<IP_Hdr>((const struct ip6_hdr*)data, false,
-		                                  static_cast<int>(len));
+		ip_hdr = NewIPHdr((const struct ip6_hdr*)data, len);
 		packet->l3_proto = L3_IPV6;
 		}
 	else
@@ -32,7 +32,17 @@ private:
 	// some missing fragments.
 	zeek::detail::FragReassembler* NextFragment(double t, const IP_Hdr* ip, const u_char* pkt);
 
+	// Returns an IP_Hdr wrapping the given header, reusing the one from a
+	// previous packet if nothing holds a reference to it anymore.
+	std::shared_ptr<IP_Hdr> NewIPHdr(const struct ip* ip4);
+	std::shared_ptr<IP_Hdr> NewIPHdr(const struct ip6_hdr* ip6, size_t len);
+
 	zeek::detail::Discarder* discarder = nullptr;
+
+	// The most recently handed out IP_Hdr. Once the packet it belongs to
+	// is done and no one else kept a reference, this is the only one left
+	// and the instance can be reused for the next packet.
+	std::shared_ptr<IP_Hdr> spare_hdr;
 	};
 
 enum class ParseResult
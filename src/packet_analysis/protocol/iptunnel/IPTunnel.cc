@@ -15,6 +15,22 @@ namespace zeek::packet_analysis::IPTunnel
 
 IPTunnelAnalyzer* ip_tunnel_analyzer;
 
+// Returns an empty encapsulation stack. The one handed out last is reused if
+// nothing refers to it anymore, which saves an allocation per tunneled packet.
+static std::shared_ptr<EncapsulationStack> new_encapsulation_stack()
+	{
+	static std::shared_ptr<EncapsulationStack> spare;
+
+	if ( spare && spare.use_count() == 1 )
+		{
+		spare->Clear();
+		return spare;
+		}
+
+	spare = std::make_shared<EncapsulationStack>();
+	return spare;
+	}
+
 IPTunnelAnalyzer::IPTunnelAnalyzer() : zeek::packet_analysis::Analyzer("IPTunnel")
 	{
 	ip_tunnel_analyzer = this;
@@ -115,7 +131,7 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt,
 	else
 		data = (const u_char*)inner->IP6_Hdr();
 
-	auto outer = prev ? prev : std::make_shared<EncapsulationStack>();
+	auto outer = prev ? prev : new_encapsulation_stack();
 	outer->Add(ec);
 
 	// Construct fake packet containing the inner packet so it can be processed
@@ -148,7 +164,7 @@ bool IPTunnelAnalyzer::ProcessEncapsulatedPacket(double t, const Packet* pkt, ui
 		ts.tv_usec = (suseconds_t)((run_state::network_time - (double)ts.tv_sec) * 1000000);
 		}
 
-	auto outer = prev ? prev : std::make_shared<EncapsulationStack>();
+	auto outer = prev ? prev : new_encapsulation_stack();
 	outer->Add(ec);
 
 	// Construct fake packet containing the inner packet so it can be processed
@@ -196,8 +212,7 @@ std::unique_ptr<Packet> build_inner_packet(Packet* outer_pkt, int* encap_index,
 		EncapsulatingConn inner(static_cast<Connection*>(outer_pkt->session), tunnel_type);
 
 		if ( ! outer_pkt->encap )
-			outer_pkt->encap = encap_stack != nullptr ? encap_stack
-			                                          : std::make_shared<EncapsulationStack>();
+			outer_pkt->encap = encap_stack != nullptr ? encap_stack : new_encapsulation_stack();
 
 		outer_pkt->encap->Add(inner);
 		inner_pkt->encap = outer_pkt->encap;
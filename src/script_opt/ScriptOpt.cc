@@ -17,6 +17,7 @@
 #include "zeek/script_opt/UsageAnalyzer.h"
 #include "zeek/script_opt/UseDefs.h"
 #include "zeek/script_opt/ZAM/Compile.h"
+#include "zeek/script_opt/ZAM/Sampler.h"
 
 namespace zeek::detail
 	{
@@ -296,6 +297,8 @@ static void init_options()
 	check_env_opt("ZEEK_NO_ZAM_OPT", analysis_options.no_ZAM_opt);
 	check_env_opt("ZEEK_DUMP_ZAM", analysis_options.dump_ZAM);
 	check_env_opt("ZEEK_PROFILE", analysis_options.profile_ZAM);
+	check_env_opt("ZEEK_SAMPLE_ZAM", analysis_options.sample_ZAM);
+	check_env_opt("ZEEK_COUNT_ZAM_SEQS", analysis_options.count_ZAM_seqs);
 
 	// Compile-to-C++-related options.
 	check_env_opt("ZEEK_GEN_CPP", analysis_options.gen_CPP);
@@ -337,6 +340,9 @@ static void init_options()
 			add_file_analysis_pattern(analysis_options, zo);
 		}
 
+	if ( analysis_options.sample_ZAM || analysis_options.count_ZAM_seqs )
+		analysis_options.activate = analysis_options.gen_ZAM = true;
+
 	if ( analysis_options.gen_ZAM )
 		{
 		analysis_options.gen_ZAM_code = true;
@@ -645,6 +651,12 @@ void analyze_scripts(bool no_unused_warnings)
 
 	if ( reporter->Errors() > 0 )
 		reporter->FatalError("Optimized script execution aborted due to errors");
+
+	if ( analysis_options.sample_ZAM )
+		start_ZAM_sampling();
+
+	if ( analysis_options.count_ZAM_seqs )
+		start_ZAM_seq_counting();
 	}
 
 void profile_script_execution()
@@ -664,6 +676,8 @@ void profile_script_execution()
 void finish_script_execution()
 	{
 	profile_script_execution();
+	finish_ZAM_sampling();
+	finish_ZAM_seq_counting();
 	}
 
 	} // namespace zeek::detail
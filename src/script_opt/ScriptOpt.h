@@ -72,6 +72,14 @@ struct AnalyOpt
 	// Produce a profile of ZAM execution.
 	bool profile_ZAM = false;
 
+	// Sample ZAM execution, producing a profile suited for flame graphs.
+	// Unlike profile_ZAM, this doesn't require a debug build.
+	bool sample_ZAM = false;
+
+	// Count which sequences of ZAM operations execute how often, to find
+	// candidates for superinstructions.
+	bool count_ZAM_seqs = false;
+
 	// If true, dump out transformed code: the results of reducing
 	// interpreted scripts, and, if optimize is set, of then optimizing
 	// them.
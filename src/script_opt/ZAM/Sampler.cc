@@ -0,0 +1,329 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Release-build profiling of ZAM execution.
+
+#include "zeek/script_opt/ZAM/Sampler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _MSC_VER
+#include <sys/time.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "zeek/Func.h"
+#include "zeek/Reporter.h"
+#include "zeek/script_opt/ZAM/ZInst.h"
+#include "zeek/util.h"
+
+namespace zeek::detail
+	{
+
+bool ZAM_profiling = false;
+volatile std::sig_atomic_t ZAM_sample_pending = 0;
+volatile std::sig_atomic_t ZAM_exec_depth = 0;
+
+// Set when a sample is due, as opposed to ZAM_sample_pending also being
+// set for counting sequences.
+static volatile std::sig_atomic_t sample_due = 0;
+
+// Samples that came due while no ZAM body was executing.
+static volatile std::sig_atomic_t num_outside_samples = 0;
+
+static bool sampling = false;
+static bool counting_seqs = false;
+static std::string sample_file;
+
+// Maps folded stacks to their number of samples.
+static std::map<std::string, uint64_t> samples;
+
+static std::string seq_file;
+
+// Maps sequences of 2 and 3 operations, each packed into an integer with
+// the first operation in the most significant position, to how often they
+// executed.
+static constexpr uint64_t num_ops = OP_NOP + 1;
+static std::unordered_map<uint64_t, uint64_t> op_pairs;
+static std::unordered_map<uint64_t, uint64_t> op_triples;
+
+// The last instruction passed to take_ZAM_sample() when counting, and the
+// number of instructions passed.
+static const ZInst* prev_inst = nullptr;
+static uint64_t num_seq_insts = 0;
+
+#ifdef __linux__
+static timer_t sample_timer;
+#endif
+
+static void sample_handler(int /* sig */)
+	{
+	if ( ZAM_exec_depth > 0 )
+		{
+		sample_due = 1;
+		ZAM_sample_pending = 1;
+		}
+	else
+		++num_outside_samples;
+	}
+
+void start_ZAM_sampling()
+	{
+#ifdef _MSC_VER
+	reporter->Error("ZAM sampling is not supported on this platform");
+#else
+	auto file = getenv("ZEEK_ZAM_SAMPLE_FILE");
+	sample_file = file ? file : "zam-samples.folded";
+
+	long rate = 997;
+
+	if ( auto r = getenv("ZEEK_ZAM_SAMPLE_RATE") )
+		{
+		rate = strtol(r, nullptr, 10);
+
+		if ( rate <= 0 || rate > 1000000 )
+			reporter->FatalError("bad ZEEK_ZAM_SAMPLE_RATE value: %s", r);
+		}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sample_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+
+	if ( sigaction(SIGPROF, &sa, nullptr) < 0 )
+		{
+		reporter->Error("can't install ZAM sampling handler: %s", strerror(errno));
+		return;
+		}
+
+#ifdef __linux__
+	// Count only the CPU time of this (the main) thread, so that time
+	// spent in logging and other threads doesn't show up as samples.
+	// The signal goes to this thread as well, since with SIGEV_SIGNAL
+	// the kernel may deliver it to any thread that doesn't block it,
+	// where the handler would find no ZAM execution to attribute it to.
+	struct sigevent sev;
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD_ID;
+	sev.sigev_signo = SIGPROF;
+#ifdef sigev_notify_thread_id
+	sev.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+#else
+	sev._sigev_un._tid = static_cast<pid_t>(syscall(SYS_gettid));
+#endif
+
+	long nsecs = 1000000000L / rate;
+	struct itimerspec its;
+	its.it_interval.tv_sec = nsecs / 1000000000L;
+	its.it_interval.tv_nsec = nsecs % 1000000000L;
+	its.it_value = its.it_interval;
+
+	if ( timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &sample_timer) < 0 )
+		{
+		reporter->Error("can't create ZAM sampling timer: %s", strerror(errno));
+		return;
+		}
+
+	if ( timer_settime(sample_timer, 0, &its, nullptr) < 0 )
+		{
+		reporter->Error("can't start ZAM sampling timer: %s", strerror(errno));
+		timer_delete(sample_timer);
+		return;
+		}
+#else
+	// Elsewhere, we have to make do with the CPU time of the process.
+	long usecs = 1000000L / rate;
+	struct itimerval itv;
+	itv.it_interval.tv_sec = usecs / 1000000L;
+	itv.it_interval.tv_usec = usecs % 1000000L;
+	itv.it_value = itv.it_interval;
+
+	if ( setitimer(ITIMER_PROF, &itv, nullptr) < 0 )
+		{
+		reporter->Error("can't start ZAM sampling timer: %s", strerror(errno));
+		return;
+		}
+#endif
+
+	sampling = true;
+	ZAM_profiling = true;
+#endif
+	}
+
+void start_ZAM_seq_counting()
+	{
+	auto file = getenv("ZEEK_ZAM_SEQ_FILE");
+	seq_file = file ? file : "zam-seqs.txt";
+
+	counting_seqs = true;
+	ZAM_profiling = true;
+	ZAM_sample_pending = 1;
+	}
+
+static void record_sample(const ZInst& z)
+	{
+	// Frames run from the outermost function call to the instruction's
+	// operation, with the instruction's script location in between.
+	// Inlined functions don't have frames of their own, but their
+	// instructions have locations in them.
+	std::string stack;
+
+	for ( const auto& ci : call_stack )
+		{
+		stack += ci.func->Name();
+		stack += ';';
+		}
+
+	if ( z.loc && z.loc->filename )
+		{
+		stack += util::detail::without_zeekpath_component(z.loc->filename);
+		stack += util::fmt(":%d;", z.loc->first_line);
+		}
+
+	stack += ZOP_name(z.op);
+
+	++samples[stack];
+	}
+
+static void count_seqs(const ZInst* z, const ZInst* end)
+	{
+	++num_seq_insts;
+
+	if ( z + 1 < end )
+		{
+		auto pair = z->op * num_ops + z[1].op;
+		++op_pairs[pair];
+
+		// If we got to z by falling through from the previous
+		// instruction, the three of them executed in sequence.
+		// (Returning from a call of another body's instructions
+		// leaves prev_inst pointing elsewhere.)
+		if ( prev_inst == z - 1 )
+			++op_triples[z[-1].op * num_ops * num_ops + pair];
+		}
+
+	prev_inst = z;
+	}
+
+void take_ZAM_sample(const ZInst* z, const ZInst* end)
+	{
+	// Clear the flag before looking at sample_due. A sample coming due
+	// from here on then sets it again, rather than us clearing it right
+	// after the handler set it, which would leave the sample pending
+	// until the next one comes due.
+	ZAM_sample_pending = 0;
+
+	if ( counting_seqs )
+		{
+		ZAM_sample_pending = 1;
+		count_seqs(z, end);
+		}
+
+	if ( sample_due )
+		{
+		sample_due = 0;
+		record_sample(*z);
+		}
+	}
+
+void finish_ZAM_sampling()
+	{
+	if ( ! sampling )
+		return;
+
+#ifdef __linux__
+	timer_delete(sample_timer);
+#else
+	struct itimerval itv;
+	memset(&itv, 0, sizeof(itv));
+	setitimer(ITIMER_PROF, &itv, nullptr);
+#endif
+
+	// The default action for SIGPROF is to terminate, so make sure
+	// that a straggler doesn't do that.
+	signal(SIGPROF, SIG_IGN);
+	sampling = false;
+	ZAM_profiling = counting_seqs;
+
+	if ( num_outside_samples > 0 )
+		samples["[outside ZAM]"] += num_outside_samples;
+
+	auto f = fopen(sample_file.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Error("can't open ZAM sample file %s: %s", sample_file.c_str(),
+		                strerror(errno));
+		return;
+		}
+
+	for ( const auto& [stack, n] : samples )
+		fprintf(f, "%s %" PRIu64 "\n", stack.c_str(), n);
+
+	fclose(f);
+	}
+
+void finish_ZAM_seq_counting()
+	{
+	if ( ! counting_seqs )
+		return;
+
+	counting_seqs = false;
+	ZAM_profiling = sampling;
+	ZAM_sample_pending = 0;
+
+	auto f = fopen(seq_file.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Error("can't open ZAM sequence file %s: %s", seq_file.c_str(),
+		                strerror(errno));
+		return;
+		}
+
+	// Each line has a count followed by the operations of its sequence,
+	// from most to least frequent, pairs and triples intermixed.
+	std::vector<std::pair<uint64_t, std::string>> seqs;
+
+	for ( const auto& [seq, n] : op_pairs )
+		{
+		auto op1 = ZOp(seq / num_ops);
+		auto op2 = ZOp(seq % num_ops);
+		seqs.emplace_back(n, util::fmt("%s %s", ZOP_name(op1), ZOP_name(op2)));
+		}
+
+	for ( const auto& [seq, n] : op_triples )
+		{
+		auto op1 = ZOp(seq / (num_ops * num_ops));
+		auto op2 = ZOp((seq / num_ops) % num_ops);
+		auto op3 = ZOp(seq % num_ops);
+		seqs.emplace_back(n,
+		                  util::fmt("%s %s %s", ZOP_name(op1), ZOP_name(op2), ZOP_name(op3)));
+		}
+
+	std::sort(seqs.begin(), seqs.end(), [](const auto& a, const auto& b)
+	          { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+	fprintf(f, "# %" PRIu64 " instructions executed without branching\n", num_seq_insts);
+
+	for ( const auto& [n, seq] : seqs )
+		fprintf(f, "%" PRIu64 " %s\n", n, seq.c_str());
+
+	fclose(f);
+	}
+
+	} // namespace zeek::detail
@@ -0,0 +1,59 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Profiling of ZAM execution that's usable in release builds.  While
+// profiling, the ZAM interpreter checks a flag after each instruction that
+// falls through to the next one, and if set, hands the instruction to
+// take_ZAM_sample().  Otherwise, it runs a variant without the check.
+// Two profiles build on this:
+//
+// Sampling: a CPU timer periodically flags that a sample is due, which is
+// then attributed to the next instruction to complete: its operation, its
+// script location, and the script call stack that led to it.  The samples
+// are written as "folded" stacks, one line per distinct stack with its
+// number of samples, which is the input format of flame graph tools (e.g.,
+// flamegraph.pl or speedscope).
+//
+// Sequence counting: the flag stays set, and each instruction counts
+// towards the pair of operations it forms with the next instruction, as
+// well as the triple if it was itself reached by falling through.  These
+// are the candidates for fusing into superinstructions.
+
+#pragma once
+
+#include <csignal>
+
+namespace zeek::detail
+	{
+
+class ZInst;
+
+// Whether either profile is on, and thus ZAM_sample_pending needs checking.
+extern bool ZAM_profiling;
+
+// Set (possibly asynchronously) when the next instruction to complete
+// should be passed to take_ZAM_sample().
+extern volatile std::sig_atomic_t ZAM_sample_pending;
+
+// The number of ZAM function bodies currently executing.  Samples falling
+// outside of them aren't attributed to ZAM instructions.
+extern volatile std::sig_atomic_t ZAM_exec_depth;
+
+// Starts sampling, writing the samples to the file given by the
+// ZEEK_ZAM_SAMPLE_FILE environment variable (default "zam-samples.folded")
+// once done.  ZEEK_ZAM_SAMPLE_RATE sets the number of samples per second
+// of CPU time (default 997).
+extern void start_ZAM_sampling();
+
+// Starts counting operation sequences, writing them to the file given by
+// ZEEK_ZAM_SEQ_FILE (default "zam-seqs.txt") once done.
+extern void start_ZAM_seq_counting();
+
+// Processes the instruction z, which was just executed and falls through
+// to the next one.  "end" points just beyond the instructions of z's body.
+extern void take_ZAM_sample(const ZInst* z, const ZInst* end);
+
+// Stop profiling and write out the profiles.
+extern void finish_ZAM_sampling();
+extern void finish_ZAM_seq_counting();
+
+	} // namespace zeek::detail
@@ -10,6 +10,7 @@
 #include "zeek/Trigger.h"
 #include "zeek/script_opt/ScriptOpt.h"
 #include "zeek/script_opt/ZAM/Compile.h"
+#include "zeek/script_opt/ZAM/Sampler.h"
 
 // Needed for managing the corresponding values.
 #include "zeek/File.h"
@@ -154,17 +155,13 @@ ZBody::ZBody(const char* _func_name, const ZAMCompiler* zc) : Stmt(STMT_ZAM)
 	double_cases = zc->GetCases<double>();
 	str_cases = zc->GetCases<std::string>();
 
-	if ( zc->NonRecursive() )
-		{
-		fixed_frame = new ZVal[frame_size];
-
-		for ( auto& ms : managed_slots )
-			fixed_frame[ms].ClearManagedVal();
-		}
-
 	table_iters = zc->GetTableIters();
 	num_step_iters = zc->NumStepIters();
 
+	// Non-recursive functions only ever need one execution state.
+	if ( zc->NonRecursive() )
+		exec_states.emplace_back(NewExecState());
+
 	// It's a little weird doing this in the constructor, but unless
 	// we add a general "initialize for ZAM" function, this is as good
 	// a place as any.
@@ -184,7 +181,6 @@ ZBody::ZBody(const char* _func_name, const ZAMCompiler* zc) : Stmt(STMT_ZAM)
 
 ZBody::~ZBody()
 	{
-	delete[] fixed_frame;
 	delete[] insts;
 	delete inst_count;
 	delete inst_CPU;
@@ -245,7 +241,9 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow)
 	double t = analysis_options.profile_ZAM ? util::curr_CPU_time() : 0.0;
 #endif
 
-	auto val = DoExec(f, flow);
+	// Only profiling needs the check for samples after each instruction,
+	// so there's a separate instance of the interpreter for it.
+	auto val = ZAM_profiling ? DoExec<true>(f, flow) : DoExec<false>(f, flow);
 
 #ifdef DEBUG
 	if ( analysis_options.profile_ZAM )
@@ -255,7 +253,7 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow)
 	return val;
 	}
 
-ValPtr ZBody::DoExec(Frame* f, StmtFlowType& flow)
+template <bool profiling> ValPtr ZBody::DoExec(Frame* f, StmtFlowType& flow)
 	{
 	int pc = 0;
 
@@ -269,32 +267,155 @@ ValPtr ZBody::DoExec(Frame* f, StmtFlowType& flow)
 	bool do_profile = analysis_options.profile_ZAM;
 #endif
 
-	ZVal* frame;
-	std::unique_ptr<TableIterVec> local_table_iters;
-	std::vector<StepIterInfo> step_iters(num_step_iters);
+	// Each level of recursion gets its own execution state, which we
+	// keep around for later calls reaching the same depth.
+	if ( exec_depth == static_cast<int>(exec_states.size()) )
+		exec_states.emplace_back(NewExecState());
+
+	auto& es = *exec_states[exec_depth++];
+	ZVal* frame = es.frame.get();
+	auto& step_iters = es.step_iters;
 
-	if ( fixed_frame )
-		frame = fixed_frame;
-	else
+	// Readies the state for the next call once we're done here, including
+	// when leaving due to an exception.
+	struct ExecStateReleaser
 		{
-		frame = new ZVal[frame_size];
-		// Clear slots for which we do explicit memory management.
-		for ( auto s : managed_slots )
-			frame[s].ClearManagedVal();
+		ZBody* body;
+		ExecState& es;
+		TableIterVec* prev_tiv_ptr;
 
-		if ( ! table_iters.empty() )
+		~ExecStateReleaser()
 			{
-			local_table_iters = std::make_unique<TableIterVec>(table_iters.size());
-			*local_table_iters = table_iters;
-			tiv_ptr = &(*local_table_iters);
+			body->ReleaseExecState(es);
+			body->tiv_ptr = prev_tiv_ptr;
+			--body->exec_depth;
+			--ZAM_exec_depth;
 			}
-		}
+		} releaser{this, es, tiv_ptr};
+
+	tiv_ptr = &es.table_iters;
+	++ZAM_exec_depth;
 
 	flow = FLOW_RETURN; // can be over-written by a Hook-Break
 
 	// Clear any leftover error state.
 	ZAM_error = false;
 
+#ifdef ZAM_THREADED_DISPATCH
+	// Rather than looping around a switch on the opcode, the code for each
+	// instruction jumps directly to the code for the next one.  Gen-ZAM
+	// generates that code with a ZAM_OP_BEGIN(op) in place of each case,
+	// which labels it and wraps it in a loop that runs once, so that
+	// "break" still moves on to the next instruction and "continue" to the
+	// one at the (updated) pc.  It lists the operations it generates code
+	// for as ZAM_OP_LABEL(op)'s.
+	//
+	// The labels come in two rows, indexed by ZAM_error, so that after an
+	// error any instruction leads out of here without a separate check.
+	static const void* op_labels[2][OP_NOP + 1];
+	static bool did_op_labels = false;
+
+	if ( ! did_op_labels )
+		{
+		for ( auto& l : op_labels[0] )
+			l = &&zam_bad_op;
+
+		for ( auto& l : op_labels[1] )
+			l = &&zam_done;
+
+#define ZAM_OP_LABEL(op) op_labels[0][op] = &&zam_##op;
+#include "ZAM-ThreadedLabels.h"
+#undef ZAM_OP_LABEL
+
+		op_labels[0][OP_NOP] = &&zam_OP_NOP;
+		did_op_labels = true;
+		}
+
+#ifdef DEBUG
+	int profile_pc = 0;
+	double profile_CPU = 0.0;
+
+#define ZAM_PROFILE_START                                                                          \
+	if ( do_profile )                                                                              \
+		{                                                                                          \
+		++ZOP_count[insts[pc].op];                                                                 \
+		++(*inst_count)[pc];                                                                       \
+		profile_pc = pc;                                                                           \
+		profile_CPU = util::curr_CPU_time();                                                       \
+		}
+
+#define ZAM_PROFILE_END                                                                            \
+	if ( do_profile )                                                                              \
+		{                                                                                          \
+		double dt = util::curr_CPU_time() - profile_CPU;                                           \
+		inst_CPU->at(profile_pc) += dt;                                                            \
+		ZOP_CPU[insts[profile_pc].op] += dt;                                                       \
+		}
+#else
+#define ZAM_PROFILE_START
+#define ZAM_PROFILE_END
+#endif
+
+// Jumps to the instruction at pc, unless we're done.
+#define ZAM_DISPATCH                                                                               \
+	{                                                                                              \
+	if ( pc >= end_pc )                                                                            \
+		goto zam_done;                                                                             \
+	ZAM_PROFILE_START                                                                              \
+	goto* op_labels[ZAM_error][insts[pc].op];                                                      \
+	}
+
+// Moves on to the instruction after the current one, first handing the
+// current one to the profiler if needed.
+#define ZAM_NEXT                                                                                   \
+	{                                                                                              \
+	ZAM_PROFILE_END                                                                                \
+	if constexpr ( profiling )                                                                     \
+		{                                                                                          \
+		if ( ZAM_sample_pending )                                                                  \
+			take_ZAM_sample(&insts[pc], &insts[end_pc]);                                           \
+		}                                                                                          \
+	++pc;                                                                                          \
+	ZAM_DISPATCH                                                                                   \
+	}
+
+// Ends the code for the previous instruction, and begins that for op.
+#define ZAM_OP_BEGIN(op)                                                                           \
+	}                                                                                              \
+	ZAM_NEXT                                                                                       \
+	zam_##op : for ( bool zam_first = true;; zam_first = false )                                   \
+		{                                                                                          \
+		if ( ! zam_first )                                                                         \
+			ZAM_DISPATCH                                                                           \
+		const auto& z = insts[pc];
+
+	ZAM_DISPATCH
+
+zam_OP_NOP:
+	for ( ;; )
+		{
+		break;
+
+		// These must stay in this order or the build fails.
+		// clang-format off
+#include "ZAM-EvalMacros.h"
+#include "ZAM-ThreadedEvalDefs.h"
+		// clang-format on
+		}
+	ZAM_NEXT
+
+zam_bad_op:
+	reporter->InternalError("bad ZAM opcode");
+
+zam_done:
+
+#undef ZAM_OP_BEGIN
+#undef ZAM_NEXT
+#undef ZAM_DISPATCH
+#undef ZAM_PROFILE_END
+#undef ZAM_PROFILE_START
+
+#else
 	while ( pc < end_pc && ! ZAM_error )
 		{
 		auto& z = insts[pc];
@@ -337,41 +458,49 @@ ValPtr ZBody::DoExec(Frame* f, StmtFlowType& flow)
 			}
 #endif
 
+		if constexpr ( profiling )
+			{
+			if ( ZAM_sample_pending )
+				take_ZAM_sample(&z, &insts[end_pc]);
+			}
+
 		++pc;
 		}
+#endif
 
-	auto result = ret_type ? ret_u->ToVal(ret_type) : nullptr;
+	return ret_type ? ret_u->ToVal(ret_type) : nullptr;
+	}
 
-	if ( fixed_frame )
-		{
-		// Make sure we don't have any dangling iterators.
-		for ( auto& ti : table_iters )
-			ti.Clear();
+std::unique_ptr<ZBody::ExecState> ZBody::NewExecState() const
+	{
+	auto es = std::make_unique<ExecState>();
 
-		// Free slots for which we do explicit memory management,
-		// preparing them for reuse.
-		for ( auto& ms : managed_slots )
-			{
-			auto& v = frame[ms];
-			ZVal::DeleteManagedType(v);
-			v.ClearManagedVal();
-			}
-		}
-	else
-		{
-		// Free those slots for which we do explicit memory management.
-		// No need to then clear them, as we're about to throw away
-		// the entire frame.
-		for ( auto& ms : managed_slots )
-			{
-			auto& v = frame[ms];
-			ZVal::DeleteManagedType(v);
-			}
+	es->frame = std::make_unique<ZVal[]>(frame_size);
 
-		delete[] frame;
-		}
+	// Clear slots for which we do explicit memory management.
+	for ( auto s : managed_slots )
+		es->frame[s].ClearManagedVal();
 
-	return result;
+	es->table_iters = table_iters;
+	es->step_iters.resize(num_step_iters);
+
+	return es;
+	}
+
+void ZBody::ReleaseExecState(ExecState& es) const
+	{
+	// Make sure we don't have any dangling iterators.
+	for ( auto& ti : es.table_iters )
+		ti.Clear();
+
+	// Free slots for which we do explicit memory management,
+	// preparing them for reuse.
+	for ( auto& ms : managed_slots )
+		{
+		auto& v = es.frame[ms];
+		ZVal::DeleteManagedType(v);
+		v.ClearManagedVal();
+		}
 	}
 
 void ZBody::ProfileExecution() const
@@ -55,7 +55,23 @@ protected:
 	// Initializes profiling information, if needed.
 	void InitProfile();
 
-	ValPtr DoExec(Frame* f, StmtFlowType& flow);
+	// Executes the body, checking after each instruction whether to
+	// take a sample if profiling.
+	template <bool profiling> ValPtr DoExec(Frame* f, StmtFlowType& flow);
+
+	// What an execution of the body needs besides its instructions.
+	struct ExecState
+		{
+		std::unique_ptr<ZVal[]> frame;
+		TableIterVec table_iters;
+		std::vector<StepIterInfo> step_iters;
+		};
+
+	// Returns a new execution state, ready for use.
+	std::unique_ptr<ExecState> NewExecState() const;
+
+	// Readies an execution state for reuse after it's been used.
+	void ReleaseExecState(ExecState& es) const;
 
 	// Run-time checking for "any" type being consistent with
 	// expected typed.  Returns true if the type match is okay.
@@ -79,23 +95,22 @@ private:
 	// A list of frame slots that correspond to managed values.
 	std::vector<int> managed_slots;
 
-	// This is non-nil if the function is (asserted to be) non-recursive,
-	// in which case we pre-allocate this.
-	ZVal* fixed_frame = nullptr;
+	// Execution states for reuse, one for each level of recursion
+	// reached so far, of which the first exec_depth are in use.  Calls
+	// thus only allocate their frames, table iteration values and so on
+	// when recursing deeper than before.  For functions that are
+	// (asserted to be) non-recursive, we pre-allocate the one state.
+	std::vector<std::unique_ptr<ExecState>> exec_states;
+	int exec_depth = 0;
 
-	// Pre-allocated table iteration values.  For recursive invocations,
-	// these are copied into a local stack variable, but for non-recursive
-	// functions they can be used directly.
+	// The table iteration values each execution state starts out with.
 	TableIterVec table_iters;
 
-	// Points to the TableIterVec used to manage iteration over tables.
-	// For non-recursive functions, we just use the static one, but
-	// for recursive ones this points to the local stack variable.
-	TableIterVec* tiv_ptr = &table_iters;
+	// Points to the TableIterVec used to manage iteration over tables,
+	// which is that of the current execution state.
+	TableIterVec* tiv_ptr = nullptr;
 
-	// Number of StepIterInfo's required by the function.  These we
-	// always create using a local stack variable, since they don't
-	// require any overhead or cleanup.
+	// Number of StepIterInfo's required by the function.
 	int num_step_iters;
 
 	std::vector<GlobalInfo> globals;
@@ -2,6 +2,8 @@
 
 #include <cstring>
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek::session::detail
 	{
 
@@ -11,32 +13,21 @@ Key::Key(const void* session, size_t size, size_t type, bool copy) : size(size),
 
 	if ( copy )
 		CopyData();
-
-	copied = copy;
 	}
 
 Key::Key(Key&& rhs)
 	{
-	data = rhs.data;
-	size = rhs.size;
-	copied = rhs.copied;
-
-	rhs.data = nullptr;
-	rhs.size = 0;
-	rhs.copied = false;
+	MoveFrom(rhs);
 	}
 
 Key& Key::operator=(Key&& rhs)
 	{
 	if ( this != &rhs )
 		{
-		data = rhs.data;
-		size = rhs.size;
-		copied = rhs.copied;
+		if ( allocated )
+			delete[] data;
 
-		rhs.data = nullptr;
-		rhs.size = 0;
-		rhs.copied = false;
+		MoveFrom(rhs);
 		}
 
 	return *this;
@@ -44,10 +35,31 @@ Key& Key::operator=(Key&& rhs)
 
 Key::~Key()
 	{
-	if ( copied )
+	if ( allocated )
 		delete[] data;
 	}
 
+void Key::MoveFrom(Key& rhs)
+	{
+	size = rhs.size;
+	type = rhs.type;
+	copied = rhs.copied;
+	allocated = rhs.allocated;
+
+	if ( rhs.copied && ! rhs.allocated )
+		{
+		memcpy(inline_data, rhs.inline_data, size);
+		data = inline_data;
+		}
+	else
+		data = rhs.data;
+
+	rhs.data = nullptr;
+	rhs.size = 0;
+	rhs.copied = false;
+	rhs.allocated = false;
+	}
+
 void Key::CopyData()
 	{
 	if ( copied )
@@ -55,6 +67,17 @@ void Key::CopyData()
 
 	copied = true;
 
+	if ( size <= INLINE_SIZE )
+		{
+		if ( size > 0 )
+			memcpy(inline_data, data, size);
+
+		data = inline_data;
+		return;
+		}
+
+	allocated = true;
+
 	uint8_t* temp = new uint8_t[size];
 	memcpy(temp, data, size);
 	data = temp;
@@ -81,3 +104,35 @@ bool Key::operator==(const Key& rhs) const
 	}
 
 	} // namespace zeek::session::detail
+
+TEST_CASE("session key storage")
+	{
+	using zeek::session::detail::Key;
+
+	uint8_t small[Key::INLINE_SIZE];
+	uint8_t large[Key::INLINE_SIZE + 1];
+	memset(small, 1, sizeof(small));
+	memset(large, 2, sizeof(large));
+
+	Key s1(small, sizeof(small), Key::CONNECTION_KEY_TYPE, true);
+	Key l1(large, sizeof(large), Key::CONNECTION_KEY_TYPE, true);
+
+	// Copies don't depend on the original data anymore.
+	small[0] = large[0] = 0;
+
+	Key s2(std::move(s1));
+	Key l2(std::move(l1));
+
+	uint8_t expect_small[Key::INLINE_SIZE];
+	uint8_t expect_large[Key::INLINE_SIZE + 1];
+	memset(expect_small, 1, sizeof(expect_small));
+	memset(expect_large, 2, sizeof(expect_large));
+
+	CHECK(s2 == Key(expect_small, sizeof(expect_small), Key::CONNECTION_KEY_TYPE));
+	CHECK(l2 == Key(expect_large, sizeof(expect_large), Key::CONNECTION_KEY_TYPE));
+	CHECK(s2.Hash() == Key(expect_small, sizeof(expect_small), Key::CONNECTION_KEY_TYPE).Hash());
+
+	s1 = std::move(l2);
+	CHECK(s1 == Key(expect_large, sizeof(expect_large), Key::CONNECTION_KEY_TYPE));
+	CHECK_FALSE(s1 == s2);
+	}
@@ -20,13 +20,20 @@ struct KeyHash;
  * the lifetime of the data pointed to by the Key. It only holds a
  * pointer. When a Key object is inserted into the SessionManager's map,
  * the data is copied into the object so the lifetime of the key data is
- * guaranteed over the lifetime of the map entry.
+ * guaranteed over the lifetime of the map entry. Data of up to INLINE_SIZE
+ * bytes, which includes connection keys, gets copied into the Key itself
+ * rather than onto the heap.
  */
 class Key final
 	{
 public:
 	const static size_t CONNECTION_KEY_TYPE = 0;
 
+	/**
+	 * The largest key size that CopyData() stores inline.
+	 */
+	static constexpr size_t INLINE_SIZE = 48;
+
 	/**
 	 * Create a new session key from a data pointer.
 	 *
@@ -55,9 +62,8 @@ public:
 	Key& operator=(const Key& rhs) = delete;
 
 	/**
-	 * Copy the data pointed at by the data pointer into a new memory location
-	 * and store it locally. This method is a no-op if the data was already
-	 * copied.
+	 * Copy the data pointed at by the data pointer into storage owned by the
+	 * Key. This method is a no-op if the data was already copied.
 	 */
 	void CopyData();
 
@@ -69,10 +75,18 @@ public:
 private:
 	friend struct KeyHash;
 
+	// Takes over rhs's data, leaving rhs empty.
+	void MoveFrom(Key& rhs);
+
 	const uint8_t* data = nullptr;
 	size_t size = 0;
 	size_t type = CONNECTION_KEY_TYPE;
 	bool copied = false;
+
+	// True if copied data lives on the heap rather than in inline_data.
+	bool allocated = false;
+
+	alignas(8) uint8_t inline_data[INLINE_SIZE];
 	};
 
 struct KeyHash
@@ -9,6 +9,7 @@
 #include <pcap.h>
 #include <unistd.h>
 #include <cstdlib>
+#include <cstring>
 
 #include "zeek/Desc.h"
 #include "zeek/Event.h"
@@ -85,6 +86,9 @@ private:
 
 	} // namespace detail
 
+// Connection keys are meant to fit into session keys without allocating.
+static_assert(sizeof(zeek::detail::ConnKey) <= detail::Key::INLINE_SIZE);
+
 Manager::Manager()
 	{
 	stats = new detail::ProtocolStats();
@@ -111,12 +115,32 @@ Connection* Manager::FindConnection(Val* v)
 Connection* Manager::FindConnection(const zeek::detail::ConnKey& conn_key)
 	{
 	detail::Key key(&conn_key, sizeof(conn_key), detail::Key::CONNECTION_KEY_TYPE, false);
+	return static_cast<Connection*>(session_map.Lookup(key, KeyHash(key)));
+	}
+
+void Manager::PrefetchConnection(const zeek::detail::ConnKey& conn_key)
+	{
+	detail::Key key(&conn_key, sizeof(conn_key), detail::Key::CONNECTION_KEY_TYPE, false);
 
-	auto it = session_map.find(key);
-	if ( it != session_map.end() )
-		return static_cast<Connection*>(it->second);
+	memcpy(prefetched_key, &conn_key, sizeof(prefetched_key));
+	prefetched_hash = key.Hash();
+	have_prefetched = true;
 
-	return nullptr;
+	session_map.Prefetch(prefetched_hash);
+	}
+
+size_t Manager::KeyHash(const detail::Key& key) const
+	{
+	if ( have_prefetched )
+		{
+		detail::Key pk(prefetched_key, sizeof(prefetched_key), detail::Key::CONNECTION_KEY_TYPE,
+		               false);
+
+		if ( key == pk )
+			return prefetched_hash;
+		}
+
+	return key.Hash();
 	}
 
 void Manager::Remove(Session* s)
@@ -129,7 +153,7 @@ void Manager::Remove(Session* s)
 
 		detail::Key key = s->SessionKey(false);
 
-		if ( session_map.erase(key) == 0 )
+		if ( ! session_map.Remove(key, KeyHash(key)) )
 			reporter->InternalWarning("connection missing");
 		else
 			{
@@ -154,11 +178,9 @@ void Manager::Insert(Session* s, bool remove_existing)
 
 	if ( remove_existing )
 		{
-		auto it = session_map.find(key);
-		if ( it != session_map.end() )
-			old = it->second;
-
-		session_map.erase(key);
+		size_t hash = KeyHash(key);
+		old = session_map.Lookup(key, hash);
+		session_map.Remove(key, hash);
 		}
 
 	InsertSession(std::move(key), s);
@@ -180,41 +202,38 @@ void Manager::Drain()
 	// every run.
 	if ( zeek::util::detail::have_random_seed() )
 		{
-		std::vector<const detail::Key*> keys;
-		keys.reserve(session_map.size());
+		std::vector<std::pair<const detail::Key*, Session*>> entries;
+		entries.reserve(session_map.Size());
 
-		for ( auto& entry : session_map )
-			keys.push_back(&(entry.first));
-		std::sort(keys.begin(), keys.end(),
-		          [](const detail::Key* a, const detail::Key* b)
+		session_map.ForEach([&entries](const detail::Key& k, Session* s)
+		                    { entries.emplace_back(&k, s); });
+		std::sort(entries.begin(), entries.end(),
+		          [](const auto& a, const auto& b)
 		          {
-					  return *a < *b;
+					  return *a.first < *b.first;
 				  });
 
-		for ( const auto* k : keys )
+		for ( const auto& [k, tc] : entries )
 			{
-			Session* tc = session_map.at(*k);
 			tc->Done();
 			tc->RemovalEvent();
 			}
 		}
 	else
 		{
-		for ( const auto& entry : session_map )
+		session_map.ForEach(
+			[](const detail::Key&, Session* tc)
 			{
-			Session* tc = entry.second;
-			tc->Done();
-			tc->RemovalEvent();
-			}
+				tc->Done();
+				tc->RemovalEvent();
+			});
 		}
 	}
 
 void Manager::Clear()
 	{
-	for ( const auto& entry : session_map )
-		Unref(entry.second);
-
-	session_map.clear();
+	session_map.ForEach([](const detail::Key&, Session* s) { Unref(s); });
+	session_map.Clear();
 
 	zeek::detail::fragment_mgr->Clear();
 	}
@@ -272,7 +291,8 @@ void Manager::InsertSession(detail::Key key, Session* session)
 	{
 	session->SetInSessionTable(true);
 	key.CopyData();
-	session_map.insert_or_assign(std::move(key), session);
+	size_t hash = KeyHash(key);
+	session_map.Insert(std::move(key), hash, session);
 
 	std::string protocol = session->TransportIdentifier();
 
@@ -3,13 +3,14 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
-#include <unordered_map>
 #include <utility>
 
 #include "zeek/Frag.h"
 #include "zeek/Hash.h"
+#include "zeek/IPAddr.h"
 #include "zeek/NetVar.h"
 #include "zeek/session/Session.h"
+#include "zeek/session/SessionTable.h"
 #include "zeek/telemetry/Manager.h"
 
 namespace zeek
@@ -74,6 +75,14 @@ public:
 	 */
 	Connection* FindConnection(const zeek::detail::ConnKey& conn_key);
 
+	/**
+	 * Prepares for an upcoming FindConnection() call for the given key by
+	 * prefetching the part of the session table where the lookup will
+	 * start. This is meant to be called for the next packet of a batch
+	 * while the current one is being processed.
+	 */
+	void PrefetchConnection(const zeek::detail::ConnKey& conn_key);
+
 	void Remove(Session* s);
 	void Insert(Session* c, bool remove_existing = true);
 
@@ -89,10 +98,9 @@ public:
 	void Weird(const char* name, const Packet* pkt, const char* addl = "", const char* source = "");
 	void Weird(const char* name, const IP_Hdr* ip, const char* addl = "");
 
-	unsigned int CurrentSessions() { return session_map.size(); }
+	unsigned int CurrentSessions() { return session_map.Size(); }
 
 private:
-	using SessionMap = std::unordered_map<detail::Key, Session*, detail::KeyHash>;
 
 	// Inserts a new connection into the sessions map. If a connection with
 	// the same key already exists in the map, it will be overwritten by
@@ -101,8 +109,17 @@ private:
 	// avoid unnecessary incrementing of connecting counts).
 	void InsertSession(detail::Key key, Session* session);
 
-	SessionMap session_map;
+	// Returns the hash of a session key, reusing the one computed by
+	// PrefetchConnection() if it was for the same key.
+	size_t KeyHash(const detail::Key& key) const;
+
+	detail::SessionTable session_map;
 	detail::ProtocolStats* stats;
+
+	// The key last passed to PrefetchConnection(), and its hash.
+	uint8_t prefetched_key[sizeof(zeek::detail::ConnKey)];
+	size_t prefetched_hash = 0;
+	bool have_prefetched = false;
 	};
 
 	} // namespace session
@@ -20,16 +20,19 @@ void Timer::Init(Session* arg_session, timer_func arg_timer, bool arg_do_expire)
 	session = arg_session;
 	timer = arg_timer;
 	do_expire = arg_do_expire;
-	Ref(session);
+
+	// The session's timer group keeps the session alive for us.
+	if ( ! session->timer_group )
+		session->timer_group = new zeek::detail::TimerGroup(session);
+
+	SetGroup(session->timer_group);
 	}
 
 Timer::~Timer()
 	{
-	if ( session->RefCnt() < 1 )
-		reporter->InternalError("reference count inconsistency in session~Timer");
-
-	session->RemoveTimer(this);
-	Unref(session);
+	// Once the session's timers are canceled, the session may be gone.
+	if ( ! IsCanceled() )
+		session->RemoveTimer(this);
 	}
 
 void Timer::Dispatch(double t, bool is_expire)
@@ -37,14 +40,13 @@ void Timer::Dispatch(double t, bool is_expire)
 	if ( is_expire && ! do_expire )
 		return;
 
-	// Remove ourselves from the session's set of timers so
-	// it doesn't try to cancel us.
 	session->RemoveTimer(this);
 
+	// The handler may cancel the session's timers, which drops the
+	// group's reference to the session.
+	Ref(session);
 	(session->*timer)(t);
-
-	if ( session->RefCnt() < 1 )
-		reporter->InternalError("reference count inconsistency in session::Timer::Dispatch");
+	Unref(session);
 	}
 
 	} // namespace detail
@@ -64,6 +66,11 @@ Session::Session(double t, EventHandlerPtr timeout_event, EventHandlerPtr status
 	installed_status_timer = 0;
 	}
 
+Session::~Session()
+	{
+	Unref(timer_group);
+	}
+
 void Session::Event(EventHandlerPtr f, analyzer::Analyzer* analyzer, const char* name)
 	{
 	if ( ! f )
@@ -100,19 +107,26 @@ void Session::SetInactivityTimeout(double timeout)
 	if ( timeout == inactivity_timeout )
 		return;
 
-	// First cancel and remove any existing inactivity timer.
-	for ( const auto& timer : timers )
-		if ( timer->Type() == zeek::detail::TIMER_CONN_INACTIVITY )
-			{
-			zeek::detail::timer_mgr->Cancel(timer);
-			break;
-			}
+	inactivity_timeout = timeout;
+
+	// A pending timer will find the timeout disabled when it fires.
+	if ( ! timeout )
+		return;
 
-	if ( timeout )
-		ADD_TIMER(&Session::InactivityTimer, last_time + timeout, 0,
-		          zeek::detail::TIMER_CONN_INACTIVITY);
+	double deadline = last_time + timeout;
 
-	inactivity_timeout = timeout;
+	if ( inactivity_timer )
+		{
+		// The timer re-arms itself if it fires early.
+		if ( inactivity_timer->Time() <= deadline )
+			return;
+
+		// Canceling the timer clears inactivity_timer via RemoveTimer().
+		zeek::detail::timer_mgr->Cancel(inactivity_timer);
+		}
+
+	inactivity_timer = ADD_TIMER(&Session::InactivityTimer, deadline, 0,
+	                             zeek::detail::TIMER_CONN_INACTIVITY);
 	}
 
 void Session::EnableStatusUpdateTimer()
@@ -131,18 +145,17 @@ void Session::EnableStatusUpdateTimer()
 
 void Session::CancelTimers()
 	{
-	// We are going to cancel our timers which, in turn, may cause them to
-	// call RemoveTimer(), which would then modify the list we're just
-	// traversing. Thus, we first make a copy of the list which we then
-	// iterate through.
-	TimerPList tmp(timers.length());
-	std::copy(timers.begin(), timers.end(), std::back_inserter(tmp));
+	timers_canceled = 1;
+	inactivity_timer = nullptr;
+
+	if ( ! timer_group )
+		return;
 
-	for ( const auto& timer : tmp )
-		zeek::detail::timer_mgr->Cancel(timer);
+	auto* group = timer_group;
+	timer_group = nullptr;
 
-	timers_canceled = 1;
-	timers.clear();
+	zeek::detail::timer_mgr->Cancel(group);
+	Unref(group);
 	}
 
 void Session::DeleteTimer(double /* t */)
@@ -153,29 +166,40 @@ void Session::DeleteTimer(double /* t */)
 	session_mgr->Remove(this);
 	}
 
-void Session::AddTimer(timer_func timer, double t, bool do_expire, zeek::detail::TimerType type)
+zeek::detail::Timer* Session::AddTimer(timer_func timer, double t, bool do_expire,
+                                       zeek::detail::TimerType type)
 	{
 	if ( timers_canceled )
-		return;
+		return nullptr;
 
 	// If the key is cleared, the session isn't stored in the session table
 	// anymore and will soon be deleted. We're not installed new timers
 	// anymore then.
 	if ( ! IsInSessionTable() )
-		return;
+		return nullptr;
 
 	zeek::detail::Timer* conn_timer = new detail::Timer(this, timer, t, do_expire, type);
 	zeek::detail::timer_mgr->Add(conn_timer);
-	timers.push_back(conn_timer);
+	return conn_timer;
 	}
 
 void Session::RemoveTimer(zeek::detail::Timer* t)
 	{
-	timers.remove(t);
+	if ( t == inactivity_timer )
+		inactivity_timer = nullptr;
 	}
 
 void Session::InactivityTimer(double t)
 	{
+	// The timeout got disabled after the timer was set.
+	if ( ! inactivity_timeout )
+		return;
+
+	// Packets of a shunted flow don't reach the session, so pick up
+	// their activity from the shunt table.
+	if ( double shunted = ShuntedLastTime(); shunted > last_time )
+		last_time = shunted;
+
 	if ( last_time + inactivity_timeout <= t )
 		{
 		Event(session_timeout_event, nullptr);
@@ -183,8 +207,12 @@ void Session::InactivityTimer(double t)
 		++zeek::detail::killed_by_inactivity;
 		}
 	else
-		ADD_TIMER(&Session::InactivityTimer, last_time + inactivity_timeout, 0,
-		          zeek::detail::TIMER_CONN_INACTIVITY);
+		{
+		// There was activity since the timer was set. Check back once
+		// the session could have become inactive.
+		inactivity_timer = ADD_TIMER(&Session::InactivityTimer, last_time + inactivity_timeout, 0,
+		                             zeek::detail::TIMER_CONN_INACTIVITY);
+		}
 	}
 
 void Session::StatusUpdateTimer(double t)
@@ -59,7 +59,7 @@ public:
 	Session(double t, EventHandlerPtr timeout_event, EventHandlerPtr status_update_event = nullptr,
 	        double status_update_interval = 0);
 
-	virtual ~Session() { }
+	~Session() override;
 
 	/**
 	 * Invoked when the session is about to be removed. Use Ref(this)
@@ -143,7 +143,7 @@ public:
 	std::enable_if_t<std::is_convertible_v<std::tuple_element_t<0, std::tuple<Args...>>, ValPtr>>
 	EnqueueEvent(EventHandlerPtr h, analyzer::Analyzer* analyzer, Args&&... args)
 		{
-		return EnqueueEvent(h, analyzer, zeek::Args{std::forward<Args>(args)...});
+		return EnqueueEvent(h, analyzer, zeek::MakeArgs(std::forward<Args>(args)...));
 		}
 
 	virtual void Describe(ODesc* d) const override;
@@ -158,6 +158,12 @@ public:
 	/**
 	 * Sets the inactivity timeout for this session.
 	 *
+	 * The inactivity timer is managed lazily: packets only update the
+	 * session's last time, and a timer firing before the session has been
+	 * inactive long enough re-arms itself for the remaining time. So a
+	 * pending timer only gets replaced here if the new timeout makes the
+	 * session expire earlier than that timer fires.
+	 *
 	 * @param timeout The number of seconds of inactivity allowed for this session
 	 * before it times out.
 	 */
@@ -174,7 +180,9 @@ public:
 	void EnableStatusUpdateTimer();
 
 	/**
-	 * Cancels all timers associated with this session.
+	 * Cancels all timers associated with this session. This is a single
+	 * operation on the session's TimerGroup, regardless of the number of
+	 * timers.
 	 */
 	void CancelTimers();
 
@@ -194,6 +202,13 @@ public:
 	 */
 	virtual std::string TransportIdentifier() const = 0;
 
+	/**
+	 * Returns the time of the last packet of the session that bypassed
+	 * it because its flow is shunted, or 0 if there was none. Such
+	 * packets still count as activity for the inactivity timeout.
+	 */
+	virtual double ShuntedLastTime() const { return 0.0; }
+
 	AnalyzerConfirmationState AnalyzerState(const zeek::Tag& tag) const;
 	void SetAnalyzerState(const zeek::Tag& tag, AnalyzerConfirmationState);
 
@@ -209,11 +224,14 @@ protected:
 	 * @param do_expire If set to true, the timer is also evaluated when Zeek
 	 * terminates.
 	 * @param type The type of timer being added.
+	 * @return The new timer, or null if the session doesn't take new
+	 * timers anymore.
 	 */
-	void AddTimer(timer_func timer, double t, bool do_expire, zeek::detail::TimerType type);
+	zeek::detail::Timer* AddTimer(timer_func timer, double t, bool do_expire,
+	                              zeek::detail::TimerType type);
 
 	/**
-	 * Remove a specific timer from firing.
+	 * Called when one of the session's timers fires or gets deleted.
 	 */
 	void RemoveTimer(zeek::detail::Timer* t);
 
@@ -231,8 +249,9 @@ protected:
 	void RemoveConnectionTimer(double t);
 
 	double start_time, last_time;
-	TimerPList timers;
+	zeek::detail::TimerGroup* timer_group = nullptr; // created with the first timer
 	double inactivity_timeout;
+	zeek::detail::Timer* inactivity_timer = nullptr; // the pending one, if any
 
 	EventHandlerPtr session_timeout_event;
 	EventHandlerPtr session_status_update_event;
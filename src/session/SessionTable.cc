@@ -0,0 +1,197 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/session/SessionTable.h"
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::session::detail
+	{
+
+// Number of slots of a new table.
+static constexpr size_t INITIAL_SIZE = 1024;
+
+// The table grows once it is more than 1/LOAD_FACTOR_INV full, keeping
+// probe sequences short.
+static constexpr size_t LOAD_FACTOR_INV = 2;
+
+SessionTable::SessionTable() : slots(Allocate(INITIAL_SIZE)), mask(INITIAL_SIZE - 1) { }
+
+SessionTable::~SessionTable() = default;
+
+std::unique_ptr<SessionTable::Slot[]> SessionTable::Allocate(size_t size)
+	{
+	return std::unique_ptr<Slot[]>(new Slot[size]);
+	}
+
+Session* SessionTable::Insert(Key key, size_t hash, Session* session)
+	{
+	for ( size_t i = hash & mask;; i = (i + 1) & mask )
+		{
+		Slot& s = slots[i];
+
+		if ( ! s.session )
+			break;
+
+		if ( s.hash == hash && s.key == key )
+			{
+			Session* old = s.session;
+			s.session = session;
+			return old;
+			}
+		}
+
+	if ( (count + 1) * LOAD_FACTOR_INV > mask + 1 )
+		Grow();
+
+	size_t i = hash & mask;
+
+	while ( slots[i].session )
+		i = (i + 1) & mask;
+
+	slots[i].hash = hash;
+	slots[i].session = session;
+	slots[i].key = std::move(key);
+	++count;
+
+	return nullptr;
+	}
+
+bool SessionTable::Remove(const Key& key, size_t hash)
+	{
+	size_t i = hash & mask;
+
+	while ( true )
+		{
+		if ( ! slots[i].session )
+			return false;
+
+		if ( slots[i].hash == hash && slots[i].key == key )
+			break;
+
+		i = (i + 1) & mask;
+		}
+
+	// Shift later entries of the probe sequence back into the gap, so
+	// that lookups never need tombstones.
+	for ( size_t j = (i + 1) & mask; slots[j].session; j = (j + 1) & mask )
+		{
+		size_t home = slots[j].hash & mask;
+
+		// The entry at j can move to i only if its home slot isn't
+		// cyclically in (i, j].
+		bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+
+		if ( stays )
+			continue;
+
+		slots[i].hash = slots[j].hash;
+		slots[i].session = slots[j].session;
+		slots[i].key = std::move(slots[j].key);
+		i = j;
+		}
+
+	slots[i].hash = 0;
+	slots[i].session = nullptr;
+	slots[i].key = Key(nullptr, 0, Key::CONNECTION_KEY_TYPE);
+	--count;
+
+	return true;
+	}
+
+void SessionTable::Clear()
+	{
+	slots = Allocate(INITIAL_SIZE);
+	mask = INITIAL_SIZE - 1;
+	count = 0;
+	}
+
+void SessionTable::Grow()
+	{
+	size_t old_size = mask + 1;
+	auto old_slots = std::move(slots);
+
+	slots = Allocate(old_size * 2);
+	mask = old_size * 2 - 1;
+
+	// The stored hashes tell us where entries go without touching the
+	// keys' data.
+	for ( size_t i = 0; i < old_size; ++i )
+		{
+		Slot& o = old_slots[i];
+
+		if ( ! o.session )
+			continue;
+
+		size_t j = o.hash & mask;
+
+		while ( slots[j].session )
+			j = (j + 1) & mask;
+
+		slots[j].hash = o.hash;
+		slots[j].session = o.session;
+		slots[j].key = std::move(o.key);
+		}
+	}
+
+	} // namespace zeek::session::detail
+
+TEST_CASE("session table")
+	{
+	using zeek::session::Session;
+	using zeek::session::detail::Key;
+	using zeek::session::detail::SessionTable;
+
+	// The table never dereferences sessions, so fake them.
+	auto fake_session = [](uint32_t i)
+	{
+		return reinterpret_cast<Session*>(uintptr_t(i + 1) * 8);
+	};
+
+	SessionTable t;
+	const uint32_t n = 5000;
+
+	for ( uint32_t i = 0; i < n; ++i )
+		{
+		Key k(&i, sizeof(i), Key::CONNECTION_KEY_TYPE, true);
+		size_t h = k.Hash();
+		CHECK(t.Insert(std::move(k), h, fake_session(i)) == nullptr);
+		}
+
+	CHECK(t.Size() == n);
+
+	for ( uint32_t i = 0; i < n; ++i )
+		{
+		Key k(&i, sizeof(i), Key::CONNECTION_KEY_TYPE);
+		REQUIRE(t.Lookup(k, k.Hash()) == fake_session(i));
+		}
+
+	// Replacing returns the previous session.
+	uint32_t v = 42;
+	Key k(&v, sizeof(v), Key::CONNECTION_KEY_TYPE, true);
+	size_t h = k.Hash();
+	CHECK(t.Insert(std::move(k), h, fake_session(4242)) == fake_session(42));
+	CHECK(t.Size() == n);
+
+	// Remove every other key, then make sure the rest are still found.
+	for ( uint32_t i = 0; i < n; i += 2 )
+		{
+		Key k(&i, sizeof(i), Key::CONNECTION_KEY_TYPE);
+		REQUIRE(t.Remove(k, k.Hash()));
+		}
+
+	CHECK(t.Size() == n / 2);
+
+	for ( uint32_t i = 0; i < n; ++i )
+		{
+		Key k(&i, sizeof(i), Key::CONNECTION_KEY_TYPE);
+		auto* expected = i % 2 ? fake_session(i) : nullptr;
+		REQUIRE(t.Lookup(k, k.Hash()) == expected);
+		}
+
+	size_t seen = 0;
+	t.ForEach([&seen](const Key&, Session*) { ++seen; });
+	CHECK(seen == n / 2);
+
+	t.Clear();
+	CHECK(t.Size() == 0);
+	}
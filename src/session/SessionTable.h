@@ -0,0 +1,138 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+#include "zeek/session/Key.h"
+
+namespace zeek::session
+	{
+
+class Session;
+
+namespace detail
+	{
+
+/**
+ * The session manager's map from keys to sessions. This is an
+ * open-addressing hash table with linear probing: all slots live in one
+ * array, and each slot stores the key's full hash next to the key itself,
+ * so that probing only compares key bytes when the hashes match, and
+ * growing the table never rehashes key data.
+ *
+ * Callers compute a key's hash once with Key::Hash() and pass it to all
+ * operations. Knowing the hash ahead of time, they can also prefetch the
+ * slot a later lookup will start at.
+ */
+class SessionTable
+	{
+public:
+	SessionTable();
+	~SessionTable();
+
+	SessionTable(const SessionTable&) = delete;
+	SessionTable& operator=(const SessionTable&) = delete;
+
+	/**
+	 * Looks up a session.
+	 *
+	 * @param key The session's key.
+	 * @param hash The key's hash, as returned by Key::Hash().
+	 * @return The session, or null if there's none for the key.
+	 */
+	Session* Lookup(const Key& key, size_t hash) const
+		{
+		for ( size_t i = hash & mask;; i = (i + 1) & mask )
+			{
+			const Slot& s = slots[i];
+
+			if ( ! s.session )
+				return nullptr;
+
+			if ( s.hash == hash && s.key == key )
+				return s.session;
+			}
+		}
+
+	/**
+	 * Inserts a session, replacing any existing one with the same key.
+	 *
+	 * @param key The session's key. It must own its data, see
+	 * Key::CopyData().
+	 * @param hash The key's hash.
+	 * @param session The session.
+	 * @return The session previously stored for the key, if any.
+	 */
+	Session* Insert(Key key, size_t hash, Session* session);
+
+	/**
+	 * Removes a session.
+	 *
+	 * @param key The session's key.
+	 * @param hash The key's hash.
+	 * @return True if there was a session for the key.
+	 */
+	bool Remove(const Key& key, size_t hash);
+
+	/**
+	 * Hints to the CPU that a lookup for the given hash is coming up.
+	 */
+	void Prefetch(size_t hash) const
+		{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(&slots[hash & mask]);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_prefetch(reinterpret_cast<const char*>(&slots[hash & mask]), _MM_HINT_T0);
+#endif
+		}
+
+	/**
+	 * Removes all sessions. This doesn't Unref() them.
+	 */
+	void Clear();
+
+	/**
+	 * Returns the number of sessions in the table.
+	 */
+	size_t Size() const { return count; }
+
+	/**
+	 * Calls a function for each key and session in the table. The
+	 * function must not modify the table.
+	 */
+	template <typename F> void ForEach(F&& f) const
+		{
+		for ( size_t i = 0; i <= mask; ++i )
+			if ( slots[i].session )
+				f(slots[i].key, slots[i].session);
+		}
+
+private:
+	struct Slot
+		{
+		Slot() : key(nullptr, 0, Key::CONNECTION_KEY_TYPE) { }
+
+		size_t hash = 0;
+		Session* session = nullptr; // null for empty slots
+		Key key;
+		};
+
+	// Returns a table of the given size, which must be a power of two.
+	static std::unique_ptr<Slot[]> Allocate(size_t size);
+
+	void Grow();
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask;
+	size_t count = 0;
+	};
+
+	} // namespace detail
+	} // namespace zeek::session
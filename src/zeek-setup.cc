@@ -443,6 +443,7 @@ static void terminate_zeek()
 	delete session_mgr;
 	delete fragment_mgr;
 	delete telemetry_mgr;
+	telemetry_mgr = nullptr;
 #ifdef HAVE_SPICY
 	delete spicy_mgr;
 #endif